@@ -1,11 +1,9 @@
 #include "jr.h"
+#include "jr_index.h"
 #include "jr_node.h"
 #include "jr_parser.h"
 #include "jr_type.h"
 /* meld-cut-here */
-#include <assert.h>
-#include <errno.h>
-#include <inttypes.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -32,7 +30,8 @@ enum offset
 {
     PARSER_OFFSET = 0,
     CURSOR_OFFSET = 1,
-    NODE_OFFSET = 2,
+    CACHE_OFFSET = 2,
+    NODE_OFFSET = __JR_HEADER,
 };
 
 static inline struct jr_parser *get_parser(struct jr jr[])
@@ -43,6 +42,10 @@ static inline struct jr_cursor *cursor(struct jr jr[])
 {
     return &jr[CURSOR_OFFSET].cursor;
 }
+static inline struct jr_cache *get_cache(struct jr jr[])
+{
+    return &jr[CACHE_OFFSET].cache;
+}
 static inline struct jr_node *nodes(struct jr jr[])
 {
     return &jr[NODE_OFFSET].node;
@@ -53,65 +56,326 @@ static inline struct jr_node *cnode(struct jr jr[])
 }
 static inline struct jr_node *sentinel(struct jr jr[])
 {
-    return &nodes(jr)[get_parser(jr)->size];
+    return &nodes(jr)[get_parser(jr)->toknext];
 }
 static inline void delimit(struct jr jr[])
 {
     cursor(jr)->json[cnode(jr)->end] = '\0';
 }
-static inline void input_errno(void)
-{
-    if (errno == EINVAL) error = JR_INVAL;
-    if (errno == ERANGE) error = JR_OUTRANGE;
-}
 static inline char *cstring(struct jr jr[])
 {
     return &cursor(jr)->json[cnode(jr)->start];
 }
+/* Leaves the breadcrumb jr_back follows, when built with JR_BACK */
+static inline struct jr *move_to(struct jr jr[], jr_idx pos)
+{
+    if (pos == cursor(jr)->pos) return jr;
+#ifdef JR_BACK
+    nodes(jr)[pos].prev = cursor(jr)->pos;
+#endif
+    cursor(jr)->pos = pos;
+    return jr;
+}
+static inline jr_idx csize(struct jr jr[])
+{
+    return cnode(jr)->end - cnode(jr)->start;
+}
+static inline char *node_string(struct jr jr[], jr_idx pos)
+{
+    return &cursor(jr)->json[nodes(jr)[pos].start];
+}
+static inline union jr_value const *node_value(struct jr jr[], jr_idx pos)
+{
+    if (!(nodes(jr)[pos].flags & JR_NODE_CACHED)) return NULL;
+    return &get_cache(jr)->values[pos];
+}
 static inline char *empty_string(struct jr jr[])
 {
+    static char nothing[1];
+    if (cursor(jr)->readonly) return nothing;
     return &cursor(jr)->json[cursor(jr)->length];
 }
+static void parse_begin(struct jr jr[]);
 static void sentinel_init(struct jr jr[]);
-static long strto_long(const char *restrict, char **restrict, int);
-static unsigned long strto_ulong(const char *restrict, char **restrict, int);
-static double strto_double(const char *restrict, char **restrict);
-static int jr_strlcpy(char *dst, const char *src, int size);
-extern void jr_parser_init(struct jr_parser *parser, int size);
+static jr_idx node_down(struct jr jr[], jr_idx pos);
+static jr_idx node_next(struct jr jr[], jr_idx pos);
+static jr_idx node_right(struct jr jr[], jr_idx pos);
+static jr_idx node_up(struct jr jr[], jr_idx pos);
+static struct jr_strview node_strview(struct jr jr[], jr_idx pos, int *err);
+static int node_text_copy(struct jr jr[], jr_idx pos, char *dst, int size,
+                          int *err);
+static bool node_bool(struct jr jr[], jr_idx pos, int *err);
+static long node_long(struct jr jr[], jr_idx pos, int *err);
+static unsigned long node_ulong(struct jr jr[], jr_idx pos, int *err);
+static double node_double(struct jr jr[], jr_idx pos, int *err);
+static bool key_match(struct jr jr[], jr_idx pos, unsigned hash, jr_idx size,
+                      char const *key);
+static void index_build(struct jr jr[], struct jr_index *);
+static int feed(struct jr jr[], jr_idx length, char *json,
+                struct jr_project const *);
+static int project_find(struct jr_project const *, int parent,
+                        char const *key, jr_idx size);
+static struct jr_step *path_push(struct jr_path *, int kind);
+static void path_key(struct jr_step *, char const *key, jr_idx size);
+static int path_int(char const **str, jr_idx *val);
+static int path_pointer(struct jr_path *, char const *expr);
+static int path_query(struct jr_path *, char const *expr);
+static int path_name(struct jr_path *, char const **expr);
+static int path_bracket(struct jr_path *, char const **expr);
+static bool path_range(struct jr_step const *, jr_idx n, jr_idx *lo,
+                       jr_idx *hi, jr_idx *stride);
+static int path_eval(struct jr jr[], struct jr_path const *, int k,
+                     jr_idx pos, jr_path_fn *, void *arg);
+static int bind_find(struct jr jr[], jr_idx pos, int size,
+                     struct jr_field const field[], int hint);
+static int bind_field(struct jr jr[], jr_idx pos, struct jr_field const *,
+                      void *dst);
+static size_t field_size(int type);
+static void *std_resize(void *ctx, void *ptr, size_t old_size,
+                        size_t new_size);
+static void std_release(void *ctx, void *ptr, size_t size);
+static int doc_resize(struct jr_doc *, size_t size);
+static struct jr_alloc const std_alloc = {std_resize, std_release, NULL};
+extern void jr_parser_init(struct jr_parser *parser, jr_idx size);
 extern void jr_parser_reset(struct jr_parser *parser);
-extern int jr_parser_parse(struct jr_parser *, int length, char *json,
-                           int nnodes, struct jr_node *);
-extern void jr_cursor_init(struct jr_cursor *cursor, int length, char *json);
-
-void __jr_init(struct jr jr[], int alloc_size)
+extern int jr_parser_parse(struct jr_parser *, jr_idx length, char *json,
+                           jr_idx nnodes, struct jr_node *,
+                           struct jr_cache const *,
+                           struct jr_project const *);
+extern int jr_parser_end(struct jr_parser *, jr_idx length, char const *json,
+                         jr_idx nnodes, struct jr_node *,
+                         struct jr_cache const *);
+extern int jr_parser_finish(struct jr_parser *, jr_idx length,
+                            char const *json);
+extern int jr_parser_sax(jr_idx length, char const *json, jr_sax_fn *,
+                         void *arg, jr_idx *offset);
+extern void jr_cursor_init(struct jr_cursor *cursor, jr_idx length,
+                           char *json);
+extern int jr_number_long(jr_idx size, char const *str, long *val);
+extern int jr_number_ulong(jr_idx size, char const *str, unsigned long *val);
+extern int jr_number_double(jr_idx size, char const *str, double *val);
+extern int jr_number_integer_double(jr_idx size, char const *str,
+                                    double *val);
+extern jr_idx jr_scan_count(jr_idx len, char const *js);
+extern int jr_unescape_span(jr_idx size, char const *src, char *dst,
+                            jr_idx cap, jr_idx *len);
+unsigned __jr_node_hash(jr_idx size, char const *str);
+
+void __jr_init(struct jr jr[], size_t alloc_size)
 {
     error = JR_OK;
-    jr_parser_init(get_parser(jr), alloc_size);
+    if (alloc_size > JR_IDX_MAX) alloc_size = JR_IDX_MAX;
+    jr_parser_init(get_parser(jr), (jr_idx)alloc_size);
+    get_cache(jr)->values = NULL;
+    get_cache(jr)->size = 0;
+    get_cache(jr)->generation = 0;
 }
 
-int jr_parse(struct jr jr[], int length, char *json)
+/* A new document, which the indexes built on the last one no longer fit */
+static void parse_begin(struct jr jr[])
 {
-    error = JR_OK;
     jr_parser_reset(get_parser(jr));
-    jr_cursor_init(cursor(jr), length, json);
+    get_cache(jr)->generation++;
+}
+
+int jr_parse(struct jr jr[], jr_idx length, char *json)
+{
+    parse_begin(jr);
+    if (jr_feed(jr, length, json)) return error;
+    return jr_finish(jr);
+}
+
+/*
+ * jr_parse for a record known to end at length, such as a line of JSON
+ * Lines, which can then also be a bare number or literal.
+ */
+int __jr_parse_record(struct jr jr[], jr_idx length, char *json)
+{
+    struct jr_parser *p = get_parser(jr);
+    parse_begin(jr);
+    if (jr_feed(jr, length, json)) return error;
+    jr_idx n = p->alloc_size - NODE_OFFSET - 1;
+    error = jr_parser_end(p, length, json, n, nodes(jr), get_cache(jr));
+    if (error) return error;
+    return jr_finish(jr);
+}
+
+/*
+ * Parse a buffer that must never be written to, such as a read-only memory
+ * mapping: jr_as_string is then unavailable in favour of jr_as_strview.
+ */
+int jr_parse_const(struct jr jr[], jr_idx length, char const *json)
+{
+    /* The parser only reads; readonly keeps the accessors from writing */
+    int rc = jr_parse(jr, length, (char *)json);
+    cursor(jr)->readonly = true;
+    return rc;
+}
+
+/*
+ * Parse as much of the first length bytes of json as possible, leaving a
+ * token cut at the end for the next call. Start with JR_INIT and end with
+ * jr_finish. Nodes are offsets into json and the accessors read the text
+ * there, so json must hold every byte received so far for as long as the
+ * document is used: it can be reallocated between calls but not trimmed.
+ * Memory is the node array plus the whole input, not only the unfinished
+ * token; what feeding saves is waiting for the last chunk before parsing.
+ */
+int jr_feed(struct jr jr[], jr_idx length, char *json)
+{
+    return feed(jr, length, json, NULL);
+}
+
+/*
+ * Parse a complete json keeping only the members on the paths of project,
+ * so that nodes and time go to what is read. Containers on a path hold
+ * nothing else, and arrays pass the filter down to their elements.
+ */
+int jr_parse_project(struct jr jr[], struct jr_project const *project,
+                     jr_idx length, char *json)
+{
+    parse_begin(jr);
+    if (feed(jr, length, json, project)) return error;
+    return jr_finish(jr);
+}
+
+int jr_finish(struct jr jr[])
+{
     struct jr_parser *p = get_parser(jr);
     struct jr_cursor *c = cursor(jr);
-    int n = p->alloc_size - 2;
-    error = jr_parser_parse(p, c->length, c->json, n, nodes(jr));
+    error = jr_parser_finish(p, c->length, c->json);
     if (error) return error;
     sentinel_init(jr);
-    if (p->size > 0) cnode(jr)->parent = -1;
+    if (p->toknext > 0) cnode(jr)->parent = -1;
+    return error;
+}
+
+/*
+ * Nodes that parsing json would take, found without building them and much
+ * faster than a parse. It is exact for valid JSON, so a document of
+ * JR_SIZE_FOR(n) entries never fails with JR_NOMEM.
+ */
+jr_idx jr_count_nodes(char const *json, jr_idx length)
+{
+    return jr_scan_count(length, json);
+}
+
+/*
+ * Check that json is well-formed without building any node, far faster than
+ * a parse: strict RFC 8259, strings of valid UTF-8 and nesting up to
+ * JR_MAX_DEPTH. offset, if not NULL, gets the byte at which the first error
+ * was found, or length.
+ */
+int jr_validate(char const *json, jr_idx length, jr_idx *offset)
+{
+    jr_idx at = 0;
+    int rc = jr_parser_sax(length, json, NULL, NULL, &at);
+    if (offset) *offset = at;
+    return rc;
+}
+
+/*
+ * Walk json as jr_validate does, calling fn with each token in document
+ * order and keeping no more than a bit per open container. fn returns
+ * JR_OK to go on, JR_SAX_SKIP on an opening bracket or a key to leave its
+ * value out, with no event and no end event for it, or anything else to
+ * stop, which is then returned. Events can precede an error further on.
+ */
+int jr_parse_sax(char const *json, jr_idx length, jr_idx *offset,
+                 jr_sax_fn *fn, void *arg)
+{
+    jr_idx at = 0;
+    int rc = jr_parser_sax(length, json, fn, arg, &at);
+    if (offset) *offset = at;
+    return rc;
+}
+
+int jr_sax_long(struct jr_sax const *sax, long *val)
+{
+    *val = 0;
+    if (sax->event != JR_SAX_NUMBER) return JR_INVAL;
+    return jr_number_long(sax->end - sax->start, sax->json + sax->start, val);
+}
+
+int jr_sax_double(struct jr_sax const *sax, double *val)
+{
+    *val = 0;
+    if (sax->event != JR_SAX_NUMBER) return JR_INVAL;
+    return jr_number_double(sax->end - sax->start, sax->json + sax->start,
+                            val);
+}
+
+/*
+ * Decode numbers into values[i] as node i is parsed, for the nodes that fit
+ * in size, so the number accessors become loads. It applies to every parse
+ * until JR_INIT or a call with a NULL values.
+ */
+void jr_cache_numbers(struct jr jr[], jr_idx size, union jr_value values[])
+{
+    get_cache(jr)->values = values;
+    get_cache(jr)->size = values ? size : 0;
+}
+
+/*
+ * Set up a document in memory from alloc, or from malloc if it is NULL, with
+ * room for size entries of struct jr to start with. The parse functions below
+ * double it whenever the nodes run out and carry on where they stopped, so
+ * doc->jr moves: take it again after each call. jr_doc_cleanup releases it.
+ */
+int jr_doc_init(struct jr_doc *doc, struct jr_alloc const *alloc, size_t size)
+{
+    doc->jr = NULL;
+    doc->size = 0;
+    doc->alloc = alloc ? alloc : &std_alloc;
+    if (size < NODE_OFFSET + 2) size = NODE_OFFSET + 2;
+    return error = doc_resize(doc, size);
+}
+
+int jr_doc_parse(struct jr_doc *doc, jr_idx length, char *json)
+{
+    parse_begin(doc->jr);
+    if (jr_doc_feed(doc, length, json)) return error;
+    return jr_finish(doc->jr);
+}
+
+int jr_doc_parse_const(struct jr_doc *doc, jr_idx length, char const *json)
+{
+    int rc = jr_doc_parse(doc, length, (char *)json);
+    cursor(doc->jr)->readonly = true;
+    return rc;
+}
+
+/* As jr_feed, growing the document instead of failing with JR_NOMEM */
+int jr_doc_feed(struct jr_doc *doc, jr_idx length, char *json)
+{
+    while (jr_feed(doc->jr, length, json) == JR_NOMEM)
+    {
+        if ((error = doc_resize(doc, doc->size * 2))) break;
+    }
     return error;
 }
 
+void jr_doc_cleanup(struct jr_doc *doc)
+{
+    if (doc->jr)
+    {
+        size_t bytes = doc->size * sizeof(struct jr);
+        doc->alloc->release(doc->alloc->ctx, doc->jr, bytes);
+    }
+    doc->jr = NULL;
+    doc->size = 0;
+}
+
 int jr_error(void) { return error; }
 
 void jr_reset(struct jr jr[])
 {
     error = JR_OK;
     cursor(jr)->pos = 0;
-    for (int i = 0; i <= get_parser(jr)->size; ++i)
+#ifdef JR_BACK
+    for (jr_idx i = 0; i <= get_parser(jr)->toknext; ++i)
         nodes(jr)[i].prev = 0;
+#endif
 }
 
 int jr_type(struct jr const jr[])
@@ -119,79 +383,52 @@ int jr_type(struct jr const jr[])
     return nodes((struct jr *)jr)[cursor((struct jr *)jr)->pos].type;
 }
 
-int jr_nchild(struct jr const jr[]) { return cnode((struct jr *)jr)->size; }
+jr_idx jr_nchild(struct jr const jr[])
+{
+    return cnode((struct jr *)jr)->size;
+}
 
+#ifdef JR_BACK
+/* Undo the last move; built with JR_BACK, which adds an index to each node */
 struct jr *jr_back(struct jr jr[])
 {
     cursor(jr)->pos = cnode(jr)->prev;
     return jr;
 }
+#endif
+
+jr_idx jr_bookmark(struct jr const jr[])
+{
+    return cursor((struct jr *)jr)->pos;
+}
 
-static struct jr *setup_sentinel(struct jr jr[])
+struct jr *jr_restore(struct jr jr[], jr_idx bookmark)
 {
-    nodes(jr)[get_parser(jr)->size].prev = cursor(jr)->pos;
-    cursor(jr)->pos = get_parser(jr)->size;
+    cursor(jr)->pos = bookmark;
     return jr;
 }
 
 struct jr *jr_down(struct jr jr[])
 {
-    if (jr_type(jr) == JR_SENTINEL) return jr;
-
-    if (cnode(jr)->size == 0) return setup_sentinel(jr);
-
-    return jr_next(jr);
+    return move_to(jr, node_down(jr, cursor(jr)->pos));
 }
 
 struct jr *jr_next(struct jr jr[])
 {
-    if (jr_type(jr) == JR_SENTINEL) return jr;
-
-    if (cursor(jr)->pos + 1 >= get_parser(jr)->size) return setup_sentinel(jr);
-
-    nodes(jr)[cursor(jr)->pos + 1].prev = cursor(jr)->pos;
-    cursor(jr)->pos++;
-    return jr;
-}
-
-static struct jr *rollback(struct jr jr[], int pos)
-{
-    while (cursor(jr_back(jr))->pos != pos)
-        ;
-    return jr;
+    return move_to(jr, node_next(jr, cursor(jr)->pos));
 }
 
 struct jr *jr_right(struct jr jr[])
 {
-    if (jr_type(jr) == JR_SENTINEL) return jr;
-
-    int parent = cnode(jr)->parent;
-    int pos = cursor(jr)->pos;
-    if (parent == -1) return setup_sentinel(jr);
-    while (parent != cnode(jr_next(jr))->parent)
-    {
-        if (jr_type(jr) == JR_SENTINEL)
-        {
-            setup_sentinel(rollback(jr, pos));
-            break;
-        }
-    }
-    return jr;
+    return move_to(jr, node_right(jr, cursor(jr)->pos));
 }
 
 struct jr *jr_up(struct jr jr[])
 {
-    if (jr_type(jr) == JR_SENTINEL) return jr;
-
-    int parent = cnode(jr)->parent;
-    if (parent == -1) return setup_sentinel(jr);
-
-    nodes(jr)[parent].prev = cursor(jr)->pos;
-    cursor(jr)->pos = parent;
-    return jr;
+    return move_to(jr, node_up(jr, cursor(jr)->pos));
 }
 
-struct jr *jr_array_at(struct jr jr[], int idx)
+struct jr *jr_array_at(struct jr jr[], jr_idx idx)
 {
     if (jr_type(jr) != JR_ARRAY)
     {
@@ -199,16 +436,16 @@ struct jr *jr_array_at(struct jr jr[], int idx)
         return jr;
     }
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_down(jr);
-    for (int i = 0; i < idx; ++i)
+    for (jr_idx i = 0; i < idx; ++i)
     {
         if (jr_type(jr) == JR_SENTINEL) break;
         jr_right(jr);
     }
     if (jr_type(jr) == JR_SENTINEL)
     {
-        rollback(jr, pos);
+        jr_restore(jr, mark);
         error = JR_OUTRANGE;
     }
     return jr;
@@ -222,13 +459,15 @@ struct jr *jr_object_at(struct jr jr[], char const *key)
         return jr;
     }
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
+    jr_idx size = (jr_idx)strlen(key);
+    unsigned hash = __jr_node_hash(size, key);
     jr_down(jr);
-    while (strcmp(jr_as_string(jr), key))
+    while (!key_match(jr, cursor(jr)->pos, hash, size, key))
     {
         if (jr_type(jr) == JR_SENTINEL)
         {
-            rollback(jr, pos);
+            jr_restore(jr, mark);
             error = JR_NOTFOUND;
             return jr;
         }
@@ -237,17 +476,147 @@ struct jr *jr_object_at(struct jr jr[], char const *key)
     return jr_down(jr);
 }
 
+/*
+ * An index follows the documents parsed into the same jr, rebuilding itself
+ * for each one, but not a new JR_INIT: call jr_index_init again after it.
+ */
+void jr_index_init(struct jr_index *index, int size, jr_idx slot[])
+{
+    index->object = -1;
+    index->generation = 0;
+    index->size = 1;
+    while (index->size * 2 <= size)
+        index->size *= 2;
+    if (size < 1) index->size = 0;
+    index->slot = slot;
+}
+
+/*
+ * Paths are added with jr_project_add into select, which takes an entry per
+ * distinct key. With stop set, a parse ends as soon as every path has been
+ * seen, leaving the rest of the input unread; paths through arrays are only
+ * complete once the outermost of those arrays closes.
+ */
+void jr_project_init(struct jr_project *project, bool stop, int size,
+                     struct jr_select select[])
+{
+    project->size = size;
+    project->count = 0;
+    project->npaths = 0;
+    project->stop = stop;
+    project->select = select;
+}
+
+/*
+ * Keep the member at path, keys separated by dots, and all that is under
+ * it. path must outlive the projection. It fails with JR_NOMEM once select
+ * is full or holds JR_PROJECT_MAX_KEYS keys, and with JR_OUTRANGE past
+ * JR_PROJECT_MAX_PATHS paths.
+ */
+int jr_project_add(struct jr_project *project, char const *path)
+{
+    if (project->npaths == JR_PROJECT_MAX_PATHS) return JR_OUTRANGE;
+
+    int parent = -1;
+    for (char const *key = path;;)
+    {
+        char const *dot = strchr(key, '.');
+        jr_idx size = (jr_idx)(dot ? (size_t)(dot - key) : strlen(key));
+        int i = project_find(project, parent, key, size);
+        if (i == -1)
+        {
+            if (project->count == project->size ||
+                project->count == JR_PROJECT_MAX_KEYS)
+                return JR_NOMEM;
+            i = project->count++;
+            struct jr_select *s = &project->select[i];
+            s->key = key;
+            s->size = size;
+            s->hash = __jr_node_hash(size, key);
+            s->parent = parent;
+            s->path = -1;
+        }
+        parent = i;
+        if (!dot) break;
+        key = dot + 1;
+    }
+
+    struct jr_select *s = &project->select[parent];
+    if (s->path == -1) s->path = project->npaths++;
+    return JR_OK;
+}
+
+/*
+ * Compile expr into at most size steps. expr is a JSON Pointer such as
+ * "/results/0/rank", or a JSONPath such as "$.results[*].rank" whose "$" is
+ * optional, with [n], [*], .*, ['key'] and [start:stop:stride] steps where
+ * negative indices count from the end of the array. Keys point into expr,
+ * which must outlive the path, and are compared as written in the document;
+ * the ~0 and ~1 escapes of JSON Pointer are not supported. It fails with
+ * JR_INVAL on a syntax error, JR_NOMEM once step is full and JR_OUTRANGE on
+ * an index beyond jr_idx.
+ */
+int jr_path_compile(struct jr_path *path, int size, struct jr_step step[],
+                    char const *expr)
+{
+    path->size = size;
+    path->count = 0;
+    path->step = step;
+    if (*expr == '/') return path_pointer(path, expr);
+    return path_query(path, expr);
+}
+
+/*
+ * Call fn with an iterator on each match, in document order, until fn
+ * returns non-zero, which is then returned. The nodes are walked once
+ * forward from the root, skipping over the subtrees no step can match.
+ */
+int jr_path_eval(struct jr_path const *path, struct jr const jr[],
+                 jr_path_fn *fn, void *arg)
+{
+    struct jr *root = (struct jr *)jr;
+    if (get_parser(root)->toknext == 0) return JR_OK;
+    return path_eval(root, path, 0, 0, fn, arg);
+}
+
+struct jr *jr_index_at(struct jr jr[], struct jr_index *index, char const *key)
+{
+    if (jr_type(jr) != JR_OBJECT)
+    {
+        error = JR_INVAL;
+        return jr;
+    }
+
+    jr_idx pos = cursor(jr)->pos;
+    unsigned generation = get_cache(jr)->generation;
+    if (index->object != pos || index->generation != generation)
+        index_build(jr, index);
+    /* Too many keys for the table: fall back to the linear scan */
+    if (index->object != pos) return jr_object_at(jr, key);
+
+    jr_idx size = (jr_idx)strlen(key);
+    unsigned hash = __jr_node_hash(size, key);
+    unsigned mask = (unsigned)index->size - 1;
+    for (unsigned i = hash & mask; index->slot[i]; i = (i + 1) & mask)
+    {
+        jr_idx k = index->slot[i] - 1;
+        if (key_match(jr, k, hash, size, key)) return jr_down(move_to(jr, k));
+    }
+    error = JR_NOTFOUND;
+    return jr;
+}
+
 char *jr_string_of(struct jr jr[], char const *key)
 {
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return empty_string(jr);
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     char *str = jr_as_string(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return str;
 }
 
@@ -255,16 +624,29 @@ void jr_strcpy_of(struct jr jr[], char const *key, char *dst, int size)
 {
     if (size > 0) dst[0] = '\0';
 
-    if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
+    struct jr_strview view = jr_strview_of(jr, key);
     if (error) return;
 
-    int pos = cursor(jr)->pos;
+    if (view.len >= (size_t)size) error = JR_NOMEM;
+    if (size <= 0) return;
+    size_t len = error ? (size_t)size - 1 : view.len;
+    memcpy(dst, view.ptr, len);
+    dst[len] = '\0';
+}
+
+struct jr_strview jr_strview_of(struct jr jr[], char const *key)
+{
+    struct jr_strview view = {empty_string(jr), 0};
+    if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
+    if (error) return view;
+
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
-    if (jr_error()) return;
+    if (jr_error()) return view;
 
-    char *str = jr_as_string(jr);
-    if (jr_strlcpy(dst, str, size) >= size) error = JR_NOMEM;
-    rollback(jr, pos);
+    view = jr_as_strview(jr);
+    jr_restore(jr, mark);
+    return view;
 }
 
 bool jr_bool_of(struct jr jr[], char const *key)
@@ -272,12 +654,12 @@ bool jr_bool_of(struct jr jr[], char const *key)
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return 0;
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     bool val = jr_as_bool(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return val;
 }
 
@@ -286,12 +668,12 @@ void *jr_null_of(struct jr jr[], char const *key)
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return 0;
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     void *val = jr_as_null(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return val;
 }
 
@@ -300,12 +682,12 @@ long jr_long_of(struct jr jr[], char const *key)
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return 0;
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     long val = jr_as_long(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return val;
 }
 
@@ -314,12 +696,12 @@ unsigned long jr_ulong_of(struct jr jr[], char const *key)
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return 0;
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     unsigned long val = jr_as_ulong(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return val;
 }
 
@@ -328,30 +710,104 @@ double jr_double_of(struct jr jr[], char const *key)
     if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
     if (error) return 0;
 
-    int pos = cursor(jr)->pos;
+    jr_idx mark = jr_bookmark(jr);
     jr_object_at(jr, key);
     if (jr_error()) return 0;
 
     double val = jr_as_double(jr);
-    rollback(jr, pos);
+    jr_restore(jr, mark);
     return val;
 }
 
+/*
+ * Fill the size fields of dst from the object under the cursor in a single
+ * walk over its keys, which leaves the cursor where it was. Each key is
+ * tried first against the field after the last one bound, so members in
+ * table order cost a comparison each. The first of duplicate keys wins, and
+ * missing and mistyped fields keep their value in dst, but for strings. A
+ * field whose size is not that of its type, but for strings, is mistyped.
+ */
+struct jr_bound jr_bind(struct jr jr[], int size, struct jr_field const field[],
+                        void *dst)
+{
+    struct jr_bound bound = {0, 0};
+    if (size < 0 || size > JR_BIND_MAX_FIELDS) error = JR_OUTRANGE;
+    else if (size > 0) bound.missing = UINT64_MAX >> (64 - size);
+    if (jr_type(jr) != JR_OBJECT) error = JR_INVAL;
+    if (error) return bound;
+
+    int hint = 0;
+    jr_idx pos = node_down(jr, cursor(jr)->pos);
+    for (; bound.missing && nodes(jr)[pos].type != JR_SENTINEL;
+         pos = node_right(jr, pos))
+    {
+        int i = bind_find(jr, pos, size, field, hint);
+        uint64_t bit = i == -1 ? 0 : (uint64_t)1 << i;
+        if (!(bound.missing & bit)) continue;
+
+        bound.missing &= ~bit;
+        if (bind_field(jr, node_down(jr, pos), &field[i], dst))
+            bound.mistyped |= bit;
+        hint = i + 1 == size ? 0 : i + 1;
+    }
+    return bound;
+}
+
 char *jr_as_string(struct jr jr[])
 {
     if (jr_type(jr) != JR_STRING) error = JR_INVAL;
+    /* There is no room for the terminator in a read-only buffer */
+    if (cursor(jr)->readonly) error = JR_INVAL;
     if (error) return empty_string(jr);
 
     delimit(jr);
     return cstring(jr);
 }
 
-bool jr_as_bool(struct jr jr[])
+/*
+ * Like jr_as_string, but with escapes decoded to UTF-8 in place. Surrogates
+ * that are not part of a pair decode to U+FFFD.
+ */
+char *jr_as_text(struct jr jr[])
+{
+    if (jr_type(jr) != JR_STRING) error = JR_INVAL;
+    if (cursor(jr)->readonly) error = JR_INVAL;
+    if (error) return empty_string(jr);
+
+    struct jr_node *node = cnode(jr);
+    if (node->flags & JR_NODE_ESCAPED)
+    {
+        jr_idx len = 0;
+        char *str = cstring(jr);
+        error = jr_unescape_span(csize(jr), str, str, csize(jr), &len);
+        if (error) return empty_string(jr);
+        node->end = node->start + len;
+        node->flags &= ~JR_NODE_ESCAPED;
+        /* Keys are looked up by the text they now hold */
+        if (node->parent >= 0 && nodes(jr)[node->parent].type == JR_OBJECT)
+            node->hash = __jr_node_hash(len, str);
+    }
+    delimit(jr);
+    return cstring(jr);
+}
+
+/*
+ * Decode the current string into dst, always terminated, and return its
+ * length. The buffer is left alone, so it works on jr_parse_const too.
+ */
+int jr_text_copy(struct jr jr[], char *dst, int size)
 {
-    if (jr_type(jr) != JR_BOOL) error = JR_INVAL;
-    if (error) return false;
+    return node_text_copy(jr, cursor(jr)->pos, dst, size, &error);
+}
 
-    return cstring(jr)[0] == 't';
+struct jr_strview jr_as_strview(struct jr jr[])
+{
+    return node_strview(jr, cursor(jr)->pos, &error);
+}
+
+bool jr_as_bool(struct jr jr[])
+{
+    return node_bool(jr, cursor(jr)->pos, &error);
 }
 
 void *jr_as_null(struct jr jr[])
@@ -362,34 +818,263 @@ void *jr_as_null(struct jr jr[])
 
 long jr_as_long(struct jr jr[])
 {
-    if (jr_type(jr) != JR_NUMBER) error = JR_INVAL;
-    if (error) return 0;
-
-    delimit(jr);
-    long val = strto_long(cstring(jr), NULL, 10);
-    input_errno();
-    return val;
+    return node_long(jr, cursor(jr)->pos, &error);
 }
 
 unsigned long jr_as_ulong(struct jr jr[])
 {
-    if (jr_type(jr) != JR_NUMBER) error = JR_INVAL;
-    if (error) return 0;
+    return node_ulong(jr, cursor(jr)->pos, &error);
+}
 
-    delimit(jr);
-    unsigned long val = strto_ulong(cstring(jr), NULL, 10);
-    input_errno();
+double jr_as_double(struct jr jr[])
+{
+    return node_double(jr, cursor(jr)->pos, &error);
+}
+
+/*
+ * An iterator reads a parsed document without writing to it, and keeps its
+ * own sticky error. Any number of them can walk the same document from
+ * different threads, as long as nothing calls the jr_* cursor functions on
+ * it meanwhile. Copy an iterator to bookmark it.
+ */
+void jr_iter_init(struct jr_iter *it, struct jr const jr[])
+{
+    it->jr = jr;
+    it->pos = 0;
+    it->error = JR_OK;
+}
+
+int jr_iter_error(struct jr_iter const *it) { return it->error; }
+
+int jr_iter_type(struct jr_iter const *it)
+{
+    return nodes((struct jr *)it->jr)[it->pos].type;
+}
+
+jr_idx jr_iter_nchild(struct jr_iter const *it)
+{
+    return nodes((struct jr *)it->jr)[it->pos].size;
+}
+
+struct jr_iter *jr_iter_down(struct jr_iter *it)
+{
+    it->pos = node_down((struct jr *)it->jr, it->pos);
+    return it;
+}
+
+struct jr_iter *jr_iter_next(struct jr_iter *it)
+{
+    it->pos = node_next((struct jr *)it->jr, it->pos);
+    return it;
+}
+
+struct jr_iter *jr_iter_right(struct jr_iter *it)
+{
+    it->pos = node_right((struct jr *)it->jr, it->pos);
+    return it;
+}
+
+struct jr_iter *jr_iter_up(struct jr_iter *it)
+{
+    it->pos = node_up((struct jr *)it->jr, it->pos);
+    return it;
+}
+
+struct jr_iter *jr_iter_array_at(struct jr_iter *it, jr_idx idx)
+{
+    struct jr *jr = (struct jr *)it->jr;
+    if (jr_iter_type(it) != JR_ARRAY) it->error = JR_INVAL;
+    if (it->error) return it;
+
+    jr_idx pos = node_down(jr, it->pos);
+    for (jr_idx i = 0; i < idx && nodes(jr)[pos].type != JR_SENTINEL; ++i)
+        pos = node_right(jr, pos);
+    if (nodes(jr)[pos].type == JR_SENTINEL) it->error = JR_OUTRANGE;
+    else it->pos = pos;
+    return it;
+}
+
+struct jr_iter *jr_iter_object_at(struct jr_iter *it, char const *key)
+{
+    struct jr *jr = (struct jr *)it->jr;
+    if (jr_iter_type(it) != JR_OBJECT) it->error = JR_INVAL;
+    if (it->error) return it;
+
+    jr_idx size = (jr_idx)strlen(key);
+    unsigned hash = __jr_node_hash(size, key);
+    jr_idx pos = node_down(jr, it->pos);
+    while (!key_match(jr, pos, hash, size, key))
+    {
+        if (nodes(jr)[pos].type == JR_SENTINEL)
+        {
+            it->error = JR_NOTFOUND;
+            return it;
+        }
+        pos = node_right(jr, pos);
+    }
+    it->pos = node_down(jr, pos);
+    return it;
+}
+
+struct jr_strview jr_iter_strview(struct jr_iter *it)
+{
+    return node_strview((struct jr *)it->jr, it->pos, &it->error);
+}
+
+int jr_iter_text_copy(struct jr_iter *it, char *dst, int size)
+{
+    return node_text_copy((struct jr *)it->jr, it->pos, dst, size, &it->error);
+}
+
+bool jr_iter_bool(struct jr_iter *it)
+{
+    return node_bool((struct jr *)it->jr, it->pos, &it->error);
+}
+
+long jr_iter_long(struct jr_iter *it)
+{
+    return node_long((struct jr *)it->jr, it->pos, &it->error);
+}
+
+unsigned long jr_iter_ulong(struct jr_iter *it)
+{
+    return node_ulong((struct jr *)it->jr, it->pos, &it->error);
+}
+
+double jr_iter_double(struct jr_iter *it)
+{
+    return node_double((struct jr *)it->jr, it->pos, &it->error);
+}
+
+static jr_idx node_down(struct jr jr[], jr_idx pos)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type == JR_SENTINEL) return pos;
+    if (node->size == 0) return get_parser(jr)->toknext;
+    return node_next(jr, pos);
+}
+
+static jr_idx node_next(struct jr jr[], jr_idx pos)
+{
+    if (nodes(jr)[pos].type == JR_SENTINEL) return pos;
+    if (pos + 1 >= get_parser(jr)->toknext) return get_parser(jr)->toknext;
+    return pos + 1;
+}
+
+static jr_idx node_right(struct jr jr[], jr_idx pos)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    jr_idx size = get_parser(jr)->toknext;
+    if (node->type == JR_SENTINEL) return pos;
+    if (node->parent == -1 || node->skip >= size) return size;
+    if (nodes(jr)[node->skip].parent != node->parent) return size;
+    return node->skip;
+}
+
+static jr_idx node_up(struct jr jr[], jr_idx pos)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type == JR_SENTINEL) return pos;
+    if (node->parent == -1) return get_parser(jr)->toknext;
+    return node->parent;
+}
+
+static struct jr_strview node_strview(struct jr jr[], jr_idx pos, int *err)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    struct jr_strview view = {empty_string(jr), 0};
+    if (node->type != JR_STRING) *err = JR_INVAL;
+    if (*err) return view;
+
+    view.ptr = node_string(jr, pos);
+    view.len = (size_t)(node->end - node->start);
+    return view;
+}
+
+static int node_text_copy(struct jr jr[], jr_idx pos, char *dst, int size,
+                          int *err)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (size > 0) dst[0] = '\0';
+    if (node->type != JR_STRING) *err = JR_INVAL;
+    if (size <= 0) *err = JR_NOMEM;
+    if (*err) return 0;
+
+    /* Strings fit in jr_idx, so a larger buffer never runs short */
+#if JR_INDEX_BITS < 64
+    jr_idx cap = size - 1 < JR_IDX_MAX ? (jr_idx)(size - 1) : JR_IDX_MAX;
+#else
+    jr_idx cap = size - 1;
+#endif
+    jr_idx len = node->end - node->start;
+    char const *str = node_string(jr, pos);
+    if (node->flags & JR_NODE_ESCAPED)
+        *err = jr_unescape_span(len, str, dst, cap, &len);
+    else
+    {
+        if (len > cap) *err = JR_NOMEM;
+        if (len > cap) len = cap;
+        memcpy(dst, str, (size_t)len);
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+static bool node_bool(struct jr jr[], jr_idx pos, int *err)
+{
+    if (nodes(jr)[pos].type != JR_BOOL) *err = JR_INVAL;
+    if (*err) return false;
+
+    return node_string(jr, pos)[0] == 't';
+}
+
+static long node_long(struct jr jr[], jr_idx pos, int *err)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type != JR_NUMBER) *err = JR_INVAL;
+    if (*err) return 0;
+    /* Floats are cached as doubles, so whole ones are decoded from text */
+    if ((node->flags & (JR_NODE_CACHED | JR_NODE_FLOAT)) == JR_NODE_CACHED)
+        return node_value(jr, pos)->integer;
+
+    long val = 0;
+    *err = jr_number_long(node->end - node->start, node_string(jr, pos), &val);
     return val;
 }
 
-double jr_as_double(struct jr jr[])
+static unsigned long node_ulong(struct jr jr[], jr_idx pos, int *err)
 {
-    if (jr_type(jr) != JR_NUMBER) error = JR_INVAL;
-    if (error) return 0;
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type != JR_NUMBER) *err = JR_INVAL;
+    if (*err) return 0;
+    if ((node->flags & (JR_NODE_CACHED | JR_NODE_FLOAT)) == JR_NODE_CACHED)
+    {
+        long cached = node_value(jr, pos)->integer;
+        if (cached < 0) *err = JR_OUTRANGE;
+        return *err ? 0 : (unsigned long)cached;
+    }
 
-    delimit(jr);
-    double val = strto_double(cstring(jr), NULL);
-    input_errno();
+    unsigned long val = 0;
+    *err = jr_number_ulong(node->end - node->start, node_string(jr, pos), &val);
+    return val;
+}
+
+static double node_double(struct jr jr[], jr_idx pos, int *err)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type != JR_NUMBER) *err = JR_INVAL;
+    if (*err) return 0;
+
+    union jr_value const *cached = node_value(jr, pos);
+    if (cached && (node->flags & JR_NODE_FLOAT)) return cached->real;
+    if (cached) return (double)cached->integer;
+
+    double val = 0;
+    jr_idx size = node->end - node->start;
+    if (node->flags & JR_NODE_INTEGER)
+        *err = jr_number_integer_double(size, node_string(jr, pos), &val);
+    else
+        *err = jr_number_double(size, node_string(jr, pos), &val);
     return val;
 }
 
@@ -399,70 +1084,395 @@ static void sentinel_init(struct jr jr[])
     sentinel(jr)->start = 0;
     sentinel(jr)->end = 1;
     sentinel(jr)->size = 0;
-    sentinel(jr)->parent = get_parser(jr)->size;
-    sentinel(jr)->prev = get_parser(jr)->size;
+    sentinel(jr)->parent = get_parser(jr)->toknext;
+    sentinel(jr)->skip = get_parser(jr)->toknext;
+#ifdef JR_BACK
+    sentinel(jr)->prev = get_parser(jr)->toknext;
+#endif
 }
 
-static long strto_long(const char *restrict nptr, char **restrict endptr,
-                       int base)
+static int bind_find(struct jr jr[], jr_idx pos, int size,
+                     struct jr_field const field[], int hint)
 {
-    errno = 0;
-    intmax_t v = strtoimax(nptr, endptr, base);
-    if (errno)
+    struct jr_node const *node = &nodes(jr)[pos];
+    char const *key = node_string(jr, pos);
+    size_t len = (size_t)(node->end - node->start);
+    for (int j = 0; j < size; ++j)
     {
-        if (v == INTMAX_MAX) return LONG_MAX;
-        if (v == INTMAX_MIN) return LONG_MIN;
-        assert(v == 0);
-        return 0;
+        int i = hint + j < size ? hint + j : hint + j - size;
+        char const *name = field[i].key;
+        if (!strncmp(name, key, len) && name[len] == '\0') return i;
+    }
+    return -1;
+}
+
+static int bind_field(struct jr jr[], jr_idx pos, struct jr_field const *f,
+                      void *dst)
+{
+    /* A member of another width would be written short or past its end */
+    if (f->type != JR_FIELD_STRING && f->size != field_size(f->type))
+        return JR_INVAL;
+
+    int err = JR_OK;
+    char *p = (char *)dst + f->offset;
+    if (f->type == JR_FIELD_BOOL)
+    {
+        bool val = node_bool(jr, pos, &err);
+        if (!err) *(bool *)p = val;
+    }
+    else if (f->type == JR_FIELD_INT)
+    {
+        long val = node_long(jr, pos, &err);
+        if (!err && (val < INT_MIN || val > INT_MAX)) err = JR_OUTRANGE;
+        if (!err) *(int *)p = (int)val;
+    }
+    else if (f->type == JR_FIELD_LONG)
+    {
+        long val = node_long(jr, pos, &err);
+        if (!err) *(long *)p = val;
+    }
+    else if (f->type == JR_FIELD_ULONG)
+    {
+        unsigned long val = node_ulong(jr, pos, &err);
+        if (!err) *(unsigned long *)p = val;
+    }
+    else if (f->type == JR_FIELD_DOUBLE)
+    {
+        double val = node_double(jr, pos, &err);
+        if (!err) *(double *)p = val;
     }
-    if (v > LONG_MAX)
+    else if (f->type == JR_FIELD_STRING)
     {
-        errno = ERANGE;
-        return LONG_MAX;
+        int size = f->size > INT_MAX ? INT_MAX : (int)f->size;
+        node_text_copy(jr, pos, p, size, &err);
     }
-    if (v < LONG_MIN)
+    else if (f->type == JR_FIELD_STRVIEW)
     {
-        errno = ERANGE;
-        return LONG_MIN;
+        struct jr_strview val = node_strview(jr, pos, &err);
+        if (!err) *(struct jr_strview *)p = val;
     }
-    return (long)v;
+    else err = JR_INVAL;
+    return err;
 }
 
-static unsigned long strto_ulong(const char *restrict nptr,
-                                 char **restrict endptr, int base)
+/* What a member of type holds, or 0 for strings and unknown types */
+static size_t field_size(int type)
 {
-    errno = 0;
-    uintmax_t v = strtoumax(nptr, endptr, base);
-    if (errno)
+    switch (type)
     {
-        if (v == UINTMAX_MAX) return ULONG_MAX;
-        assert(v == 0);
+    case JR_FIELD_BOOL:
+        return sizeof(bool);
+    case JR_FIELD_INT:
+        return sizeof(int);
+    case JR_FIELD_LONG:
+        return sizeof(long);
+    case JR_FIELD_ULONG:
+        return sizeof(unsigned long);
+    case JR_FIELD_DOUBLE:
+        return sizeof(double);
+    case JR_FIELD_STRVIEW:
+        return sizeof(struct jr_strview);
+    default:
         return 0;
     }
-    if (v > ULONG_MAX)
+}
+
+static bool key_match(struct jr jr[], jr_idx pos, unsigned hash, jr_idx size,
+                      char const *key)
+{
+    struct jr_node const *node = &nodes(jr)[pos];
+    if (node->type != JR_STRING || node->hash != hash) return false;
+    if (node->end - node->start != size) return false;
+    return !memcmp(&cursor(jr)->json[node->start], key, size);
+}
+
+static struct jr_step *path_push(struct jr_path *path, int kind)
+{
+    if (path->count == path->size) return NULL;
+    struct jr_step *s = &path->step[path->count++];
+    s->kind = kind;
+    s->key = NULL;
+    s->size = 0;
+    s->hash = 0;
+    s->start = -1;
+    s->stop = JR_IDX_MAX;
+    s->stride = 1;
+    return s;
+}
+
+static void path_key(struct jr_step *s, char const *key, jr_idx size)
+{
+    s->key = key;
+    s->size = size;
+    s->hash = __jr_node_hash(size, key);
+}
+
+static int path_int(char const **str, jr_idx *val)
+{
+    char const *p = *str;
+    bool neg = *p == '-';
+    if (neg) ++p;
+    if (*p < '0' || *p > '9') return JR_INVAL;
+
+    jr_idx v = 0;
+    for (; *p >= '0' && *p <= '9'; ++p)
+    {
+        int d = *p - '0';
+        if (v > (JR_IDX_MAX - d) / 10) return JR_OUTRANGE;
+        v = (jr_idx)(v * 10 + d);
+    }
+    *val = neg ? (jr_idx)-v : v;
+    *str = p;
+    return JR_OK;
+}
+
+static int path_pointer(struct jr_path *path, char const *expr)
+{
+    while (*expr == '/')
+    {
+        char const *key = ++expr;
+        expr += strcspn(expr, "/");
+        jr_idx size = (jr_idx)(expr - key);
+        if (memchr(key, '~', (size_t)size)) return JR_INVAL;
+
+        struct jr_step *s = path_push(path, JR_STEP_KEY);
+        if (!s) return JR_NOMEM;
+        path_key(s, key, size);
+        /* Array indices are written without sign or leading zeros */
+        char const *p = key;
+        jr_idx idx = 0;
+        if (*key != '-' && (*key != '0' || size == 1) && !path_int(&p, &idx) &&
+            p == expr)
+            s->start = idx;
+    }
+    return JR_OK;
+}
+
+static int path_query(struct jr_path *path, char const *expr)
+{
+    char const *p = expr;
+    if (*p == '$') ++p;
+    while (*p)
     {
-        errno = ERANGE;
-        return ULONG_MAX;
+        int rc = JR_INVAL;
+        if (*p == '[') rc = path_bracket(path, &p);
+        /* The first key may leave out its dot */
+        else if (*p == '.' || p == expr)
+        {
+            if (*p == '.') ++p;
+            rc = path_name(path, &p);
+        }
+        if (rc) return rc;
     }
-    return (unsigned long)v;
+    return JR_OK;
 }
 
-static double strto_double(const char *restrict nptr, char **restrict endptr)
+static int path_name(struct jr_path *path, char const **expr)
 {
-    errno = 0;
-    return strtod(nptr, endptr);
+    char const *key = *expr;
+    jr_idx size = (jr_idx)strcspn(key, ".[");
+    if (size == 0) return JR_INVAL;
+    *expr = key + size;
+
+    bool any = size == 1 && *key == '*';
+    struct jr_step *s = path_push(path, any ? JR_STEP_ANY : JR_STEP_KEY);
+    if (!s) return JR_NOMEM;
+    if (!any) path_key(s, key, size);
+    return JR_OK;
 }
 
-static int jr_strlcpy(char *dst, const char *src, int size)
+static int path_bracket(struct jr_path *path, char const **expr)
 {
-    int ret = (int)strlen(src);
+    char const *p = *expr + 1;
+    struct jr_step *s = path_push(path, JR_STEP_INDEX);
+    if (!s) return JR_NOMEM;
 
-    if (size > 0)
+    int rc = JR_OK;
+    if (*p == '*')
     {
-        int len = (ret >= size) ? size - 1 : ret;
-        memcpy(dst, src, len);
-        dst[len] = '\0';
+        s->kind = JR_STEP_ANY;
+        ++p;
     }
-    return ret;
+    else if (*p == '\'' || *p == '"')
+    {
+        char const *end = strchr(p + 1, *p);
+        if (!end) return JR_INVAL;
+        s->kind = JR_STEP_KEY;
+        path_key(s, p + 1, (jr_idx)(end - p - 1));
+        p = end + 1;
+    }
+    else
+    {
+        s->start = 0;
+        if (*p != ':' && (rc = path_int(&p, &s->start))) return rc;
+        if (*p == ':')
+        {
+            s->kind = JR_STEP_SLICE;
+            ++p;
+            if (*p != ':' && *p != ']' && (rc = path_int(&p, &s->stop)))
+                return rc;
+            if (*p == ':' && *(++p) != ']' && (rc = path_int(&p, &s->stride)))
+                return rc;
+            if (s->stride <= 0) return JR_INVAL;
+        }
+    }
+    if (*p != ']') return JR_INVAL;
+    *expr = p + 1;
+    return JR_OK;
+}
+
+static jr_idx path_bound(jr_idx i, jr_idx n)
+{
+    if (i < 0) i = (jr_idx)(i + n);
+    return i < 0 ? 0 : (i > n ? n : i);
+}
+
+/* The elements [lo, hi) of an array of n that the step selects */
+static bool path_range(struct jr_step const *s, jr_idx n, jr_idx *lo,
+                       jr_idx *hi, jr_idx *stride)
+{
+    *lo = 0;
+    *hi = n;
+    *stride = 1;
+    if (s->kind == JR_STEP_KEY || s->kind == JR_STEP_INDEX)
+    {
+        jr_idx i = s->start;
+        if (s->kind == JR_STEP_INDEX && i < 0) i = (jr_idx)(i + n);
+        if (i < 0 || i >= n) return false;
+        *lo = i;
+        *hi = (jr_idx)(i + 1);
+    }
+    else if (s->kind == JR_STEP_SLICE)
+    {
+        *lo = path_bound(s->start, n);
+        *hi = path_bound(s->stop, n);
+        *stride = s->stride;
+    }
+    return *lo < *hi;
+}
+
+static int path_eval(struct jr jr[], struct jr_path const *path, int k,
+                     jr_idx pos, jr_path_fn *fn, void *arg)
+{
+    if (k == path->count)
+    {
+        struct jr_iter it;
+        jr_iter_init(&it, jr);
+        it.pos = pos;
+        return fn(&it, arg);
+    }
+
+    struct jr_step const *s = &path->step[k];
+    struct jr_node const *node = &nodes(jr)[pos];
+    bool object = node->type == JR_OBJECT;
+    jr_idx lo = 0, hi = node->size, stride = 1;
+    if (object && s->kind != JR_STEP_KEY && s->kind != JR_STEP_ANY)
+        return JR_OK;
+    if (!object && node->type != JR_ARRAY) return JR_OK;
+    if (!object && !path_range(s, node->size, &lo, &hi, &stride)) return JR_OK;
+
+    jr_idx child = node_down(jr, pos);
+    for (jr_idx i = 0; i < hi && nodes(jr)[child].type != JR_SENTINEL; ++i)
+    {
+        int rc = JR_OK;
+        if (!object && i >= lo && (i - lo) % stride == 0)
+            rc = path_eval(jr, path, k + 1, child, fn, arg);
+        else if (object && s->kind == JR_STEP_ANY)
+            rc = path_eval(jr, path, k + 1, node_down(jr, child), fn, arg);
+        else if (object && key_match(jr, child, s->hash, s->size, s->key))
+            return path_eval(jr, path, k + 1, node_down(jr, child), fn, arg);
+        if (rc) return rc;
+        child = node_right(jr, child);
+    }
+    return JR_OK;
+}
+
+static void index_build(struct jr jr[], struct jr_index *index)
+{
+    jr_idx pos = cursor(jr)->pos;
+    struct jr_node const *object = cnode(jr);
+    index->object = -1;
+    /* Keep the load factor at or below one half */
+    if (index->size == 0 || object->size * 2 > index->size) return;
+
+    memset(index->slot, 0, index->size * sizeof(index->slot[0]));
+    unsigned mask = (unsigned)index->size - 1;
+    for (jr_idx k = pos + 1; k < object->skip; k = nodes(jr)[k].skip)
+    {
+        struct jr_node const *node = &nodes(jr)[k];
+        char const *key = &cursor(jr)->json[node->start];
+        jr_idx size = node->end - node->start;
+        unsigned i = node->hash & mask;
+        while (index->slot[i] &&
+               !key_match(jr, index->slot[i] - 1, node->hash, size, key))
+            i = (i + 1) & mask;
+        /* First occurrence wins, as it does for jr_object_at */
+        if (!index->slot[i]) index->slot[i] = k + 1;
+    }
+    index->object = pos;
+    index->generation = get_cache(jr)->generation;
+}
+
+
+static int feed(struct jr jr[], jr_idx length, char *json,
+                struct jr_project const *project)
+{
+    error = length < JR_IDX_MAX ? JR_OK : JR_OUTRANGE;
+    if (error) return error;
+
+    jr_cursor_init(cursor(jr), length, json);
+    struct jr_parser *p = get_parser(jr);
+    /* Keep a slot for the sentinel, which goes right after the last node */
+    jr_idx n = p->alloc_size - NODE_OFFSET - 1;
+    error = jr_parser_parse(p, length, json, n, nodes(jr), get_cache(jr),
+                            project);
+    return error;
+}
+
+static int project_find(struct jr_project const *project, int parent,
+                        char const *key, jr_idx size)
+{
+    for (int i = 0; i < project->count; ++i)
+    {
+        struct jr_select const *s = &project->select[i];
+        if (s->parent == parent && s->size == size &&
+            !memcmp(s->key, key, size))
+            return i;
+    }
+    return -1;
+}
+
+static void *std_resize(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void std_release(void *ctx, void *ptr, size_t size)
+{
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+/* Nodes hold offsets only, so the whole document can move */
+static int doc_resize(struct jr_doc *doc, size_t size)
+{
+    size_t max = SIZE_MAX / sizeof(struct jr);
+    if (size > JR_IDX_MAX) size = JR_IDX_MAX;
+    if (size > max) size = max;
+    if (size <= doc->size) return JR_NOMEM;
+
+    struct jr_alloc const *a = doc->alloc;
+    size_t old_bytes = doc->size * sizeof(struct jr);
+    struct jr *jr = a->resize(a->ctx, doc->jr, old_bytes, size * sizeof(*jr));
+    if (jr == NULL) return JR_NOMEM;
+
+    if (doc->jr == NULL) __jr_init(jr, size);
+    else get_parser(jr)->alloc_size = (jr_idx)size;
+    doc->jr = jr;
+    doc->size = size;
+    return JR_OK;
 }
 /* meld-cut-here */
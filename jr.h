@@ -2,10 +2,20 @@
 #define JR_H
 
 #include "jr_cursor.h"
+#include "jr_doc.h"
 #include "jr_error.h"
+#include "jr_field.h"
+#include "jr_idx.h"
+#include "jr_index.h"
+#include "jr_iter.h"
 #include "jr_node.h"
 #include "jr_parser.h"
+#include "jr_path.h"
+#include "jr_project.h"
+#include "jr_sax.h"
+#include "jr_strview.h"
 #include "jr_type.h"
+#include "jr_value.h"
 
 /* meld-cut-here */
 #include <stdbool.h>
@@ -18,6 +28,7 @@ struct jr
     {
         struct jr_parser parser;
         struct jr_cursor cursor;
+        struct jr_cache cache;
         struct jr_node node;
     };
 };
@@ -26,38 +37,101 @@ struct jr
 
 #define JR_DECLARE(name, size) struct jr name[size];
 #define JR_INIT(name) __jr_init((name), __JR_ARRAY_SIZE(name))
+/* Entries of struct jr ahead of the nodes: parser, cursor and cache */
+#define __JR_HEADER 3
+/* Entries of struct jr for nnodes nodes, as counted by jr_count_nodes */
+#define JR_SIZE_FOR(nnodes) ((nnodes) + __JR_HEADER + 1)
+
+void __jr_init(struct jr[], size_t alloc_size);
+int __jr_parse_record(struct jr[], jr_idx length, char *json);
+int jr_parse(struct jr[], jr_idx length, char *json);
+int jr_parse_const(struct jr[], jr_idx length, char const *json);
+int jr_feed(struct jr[], jr_idx length, char *json);
+int jr_finish(struct jr[]);
+int jr_parse_project(struct jr[], struct jr_project const *, jr_idx length,
+                     char *json);
+jr_idx jr_count_nodes(char const *json, jr_idx length);
+int jr_validate(char const *json, jr_idx length, jr_idx *offset);
+int jr_parse_sax(char const *json, jr_idx length, jr_idx *offset,
+                 jr_sax_fn *, void *arg);
+int jr_sax_long(struct jr_sax const *, long *);
+int jr_sax_double(struct jr_sax const *, double *);
+void jr_cache_numbers(struct jr[], jr_idx size, union jr_value[]);
+
+int jr_doc_init(struct jr_doc *, struct jr_alloc const *, size_t size);
+int jr_doc_parse(struct jr_doc *, jr_idx length, char *json);
+int jr_doc_parse_const(struct jr_doc *, jr_idx length, char const *json);
+int jr_doc_feed(struct jr_doc *, jr_idx length, char *json);
+void jr_doc_cleanup(struct jr_doc *);
 
-void __jr_init(struct jr[], int alloc_size);
-int jr_parse(struct jr[], int length, char *json);
 int jr_error(void);
 char const *jr_strerror(int code);
 void jr_reset(struct jr[]);
 int jr_type(struct jr const[]);
-int jr_nchild(struct jr const[]);
+jr_idx jr_nchild(struct jr const[]);
 
+#ifdef JR_BACK
 struct jr *jr_back(struct jr[]);
+#endif
 struct jr *jr_down(struct jr[]);
 struct jr *jr_next(struct jr[]);
 struct jr *jr_right(struct jr[]);
 struct jr *jr_up(struct jr[]);
+jr_idx jr_bookmark(struct jr const[]);
+struct jr *jr_restore(struct jr[], jr_idx bookmark);
 
-struct jr *jr_array_at(struct jr[], int idx);
+struct jr *jr_array_at(struct jr[], jr_idx idx);
 struct jr *jr_object_at(struct jr[], char const *key);
 
+void jr_project_init(struct jr_project *, bool stop, int size,
+                     struct jr_select select[]);
+int jr_project_add(struct jr_project *, char const *path);
+
+int jr_path_compile(struct jr_path *, int size, struct jr_step step[],
+                    char const *expr);
+int jr_path_eval(struct jr_path const *, struct jr const[], jr_path_fn *,
+                 void *arg);
+
+void jr_index_init(struct jr_index *, int size, jr_idx slot[]);
+struct jr *jr_index_at(struct jr[], struct jr_index *, char const *key);
+
 char *jr_string_of(struct jr[], char const *key);
 void jr_strcpy_of(struct jr[], char const *key, char *dst, int size);
+struct jr_strview jr_strview_of(struct jr[], char const *key);
 bool jr_bool_of(struct jr[], char const *key);
 void *jr_null_of(struct jr[], char const *key);
 long jr_long_of(struct jr[], char const *key);
 unsigned long jr_ulong_of(struct jr[], char const *key);
 double jr_double_of(struct jr[], char const *key);
+struct jr_bound jr_bind(struct jr[], int size, struct jr_field const[],
+                        void *dst);
 
 char *jr_as_string(struct jr[]);
+struct jr_strview jr_as_strview(struct jr[]);
+char *jr_as_text(struct jr[]);
+int jr_text_copy(struct jr[], char *dst, int size);
 bool jr_as_bool(struct jr[]);
 void *jr_as_null(struct jr[]);
 long jr_as_long(struct jr[]);
 unsigned long jr_as_ulong(struct jr[]);
 double jr_as_double(struct jr[]);
+
+void jr_iter_init(struct jr_iter *, struct jr const[]);
+int jr_iter_error(struct jr_iter const *);
+int jr_iter_type(struct jr_iter const *);
+jr_idx jr_iter_nchild(struct jr_iter const *);
+struct jr_iter *jr_iter_down(struct jr_iter *);
+struct jr_iter *jr_iter_next(struct jr_iter *);
+struct jr_iter *jr_iter_right(struct jr_iter *);
+struct jr_iter *jr_iter_up(struct jr_iter *);
+struct jr_iter *jr_iter_array_at(struct jr_iter *, jr_idx idx);
+struct jr_iter *jr_iter_object_at(struct jr_iter *, char const *key);
+struct jr_strview jr_iter_strview(struct jr_iter *);
+int jr_iter_text_copy(struct jr_iter *, char *dst, int size);
+bool jr_iter_bool(struct jr_iter *);
+long jr_iter_long(struct jr_iter *);
+unsigned long jr_iter_ulong(struct jr_iter *);
+double jr_iter_double(struct jr_iter *);
 /* meld-cut-here */
 
 #endif
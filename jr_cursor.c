@@ -1,10 +1,12 @@
 #include "jr_cursor.h"
 
 /* meld-cut-here */
-extern void jr_cursor_init(struct jr_cursor *cursor, int length, char *json)
+extern void jr_cursor_init(struct jr_cursor *cursor, jr_idx length,
+                           char *json)
 {
     cursor->length = length;
     cursor->json = json;
     cursor->pos = 0;
+    cursor->readonly = false;
 }
 /* meld-cut-here */
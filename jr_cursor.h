@@ -1,12 +1,17 @@
 #ifndef JR_CURSOR_H
 #define JR_CURSOR_H
 
+#include "jr_idx.h"
+
 /* meld-cut-here */
+#include <stdbool.h>
+
 struct jr_cursor
 {
-    int length;
     char *json;
-    int pos;
+    jr_idx length;
+    jr_idx pos;
+    bool readonly;
 };
 /* meld-cut-here */
 
@@ -0,0 +1,28 @@
+#ifndef JR_DOC_H
+#define JR_DOC_H
+
+/* meld-cut-here */
+#include <stddef.h>
+
+struct jr;
+
+/*
+ * Memory for growable documents. resize behaves as realloc and is also
+ * called with a NULL ptr and an old_size of 0 for the first block.
+ */
+struct jr_alloc
+{
+    void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*release)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+};
+
+struct jr_doc
+{
+    struct jr *jr;
+    size_t size;
+    struct jr_alloc const *alloc;
+};
+/* meld-cut-here */
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JR_FIELD_H
+#define JR_FIELD_H
+
+/* meld-cut-here */
+#include <stddef.h>
+#include <stdint.h>
+
+enum jr_field_type
+{
+    JR_FIELD_BOOL,
+    JR_FIELD_INT,
+    JR_FIELD_LONG,
+    JR_FIELD_ULONG,
+    JR_FIELD_DOUBLE,
+    JR_FIELD_STRING,  /* unescaped copy into a char array */
+    JR_FIELD_STRVIEW, /* struct jr_strview into the buffer */
+};
+
+/* A member of the struct jr_bind fills, and the key it is read from */
+struct jr_field
+{
+    char const *key;
+    int type;
+    size_t offset;
+    size_t size;
+};
+
+/*
+ * Table entries from an X-macro list of (struct, member, type) triples:
+ *
+ *     #define PERSON_FIELDS(X) X(struct person, name, STRING)
+ *     static struct jr_field const person[] = {PERSON_FIELDS(JR_FIELD)};
+ */
+#define JR_FIELD(S, M, T)                                                      \
+    {#M, JR_FIELD_##T, offsetof(S, M), sizeof(((S *)0)->M)},
+
+/* Bit i stands for field i of the table */
+enum
+{
+    JR_BIND_MAX_FIELDS = 64
+};
+
+struct jr_bound
+{
+    uint64_t missing;
+    uint64_t mistyped;
+};
+/* meld-cut-here */
+
+#endif
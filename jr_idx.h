@@ -0,0 +1,30 @@
+#ifndef JR_IDX_H
+#define JR_IDX_H
+
+/* meld-cut-here */
+#include <stdint.h>
+
+/*
+ * Width of node indices and text offsets. Sixteen bits shrink the nodes of
+ * documents under 32 KiB, such as the records of a JSON Lines file; 64 bits
+ * take documents past 2 GiB.
+ */
+#ifndef JR_INDEX_BITS
+#define JR_INDEX_BITS 32
+#endif
+
+#if JR_INDEX_BITS == 16
+typedef int16_t jr_idx;
+#define JR_IDX_MAX INT16_MAX
+#elif JR_INDEX_BITS == 32
+typedef int32_t jr_idx;
+#define JR_IDX_MAX INT32_MAX
+#elif JR_INDEX_BITS == 64
+typedef int64_t jr_idx;
+#define JR_IDX_MAX INT64_MAX
+#else
+#error "JR_INDEX_BITS must be 16, 32 or 64"
+#endif
+/* meld-cut-here */
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef JR_INDEX_H
+#define JR_INDEX_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+struct jr_index
+{
+    jr_idx object;
+    unsigned generation; /* of the parse object belongs to */
+    int size;
+    jr_idx *slot;
+};
+/* meld-cut-here */
+
+#endif
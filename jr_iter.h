@@ -0,0 +1,17 @@
+#ifndef JR_ITER_H
+#define JR_ITER_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+struct jr;
+
+struct jr_iter
+{
+    struct jr const *jr;
+    jr_idx pos;
+    int error;
+};
+/* meld-cut-here */
+
+#endif
@@ -0,0 +1,362 @@
+#include "jr_lines.h"
+#include "jr.h"
+#include "jr_scan.h"
+
+/* meld-cut-here */
+#include <pthread.h>
+#include <string.h>
+
+/*
+ * Iterate over the newline-delimited records of json, which can be a
+ * buffer or a private (copy-on-write) memory mapping of a whole file.
+ * Offsets are 64-bit whatever JR_INDEX_BITS: only records are bounded by it.
+ */
+void jr_lines_init(struct jr_lines *lines, int64_t length, char *json)
+{
+    lines->length = length;
+    lines->json = json;
+    lines->pos = 0;
+    lines->start = 0;
+}
+
+/*
+ * Parse the next non-blank record into jr, reusing its nodes. Returns false
+ * once the input is exhausted; jr_error() tells whether the record parsed.
+ */
+bool jr_lines_next(struct jr_lines *lines, struct jr jr[])
+{
+    int64_t pos = lines->pos;
+    /* Blank lines can outrun jr_idx, so they are skipped a span at a time */
+    while (pos < lines->length)
+    {
+        int64_t left = lines->length - pos;
+        jr_idx span = left < JR_IDX_MAX ? (jr_idx)left : JR_IDX_MAX;
+        jr_idx skip = jr_scan_space(0, span, &lines->json[pos]);
+        pos += skip;
+        if (skip < span) break;
+    }
+    if (pos >= lines->length) return false;
+
+    char *json = &lines->json[pos];
+    char *newline = memchr(json, '\n', (size_t)(lines->length - pos));
+    int64_t size = newline ? newline - json : lines->length - pos;
+
+    lines->start = pos;
+    lines->pos = pos + size;
+    /* A record too long for jr_idx fails with JR_OUTRANGE */
+    __jr_parse_record(jr, size < JR_IDX_MAX ? (jr_idx)size : JR_IDX_MAX, json);
+    return true;
+}
+
+/* Records parsed ahead of their turn before an ordered worker must wait */
+#define JR_LINES_BATCH 64
+
+struct lines_pending
+{
+    int offset;
+    int rc;
+    int64_t start;
+};
+
+struct lines_shared
+{
+    int64_t length;
+    char *json;
+    int nchunks;
+    int64_t chunk;
+    bool ordered;
+    jr_lines_fn *fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int taken; /* chunks handed out in ordered mode */
+    int next;  /* chunk whose turn it is to deliver */
+    int stop;
+};
+
+struct lines_worker
+{
+    struct lines_shared *shared;
+    struct lines_worker *workers;
+    int id;
+    int nworkers;
+    pthread_mutex_t lock;
+    int lo;
+    int hi;
+    int size;
+    struct jr *pool;
+    struct lines_pending pending[JR_LINES_BATCH];
+};
+
+static void *lines_work(void *arg);
+static int lines_take(struct lines_worker *);
+static int64_t lines_boundary(struct lines_shared const *, int chunk);
+static void lines_chunk(struct lines_worker *, int chunk);
+static void lines_chunk_ordered(struct lines_worker *, int chunk);
+static bool lines_flush(struct lines_worker *, int chunk, bool *turn,
+                        int npending);
+static int lines_deliver(struct lines_shared *, struct jr[], int rc,
+                         int64_t start);
+static int lines_slots(struct jr const[], int rc);
+static int lines_stopped(struct lines_shared *);
+static void lines_stop(struct lines_shared *, int rc);
+
+/*
+ * Parse the remaining records on nthreads threads and hand each one to fn,
+ * together with its parse status and byte offset, in the worker's share of
+ * pool. The input is cut into chunks at newlines; each worker drains its own
+ * run of chunks and then steals from the end of the others, so fn is called
+ * from several threads at once and must guard what it shares. When ordered
+ * is set, calls are serialized and come in input order: workers take the
+ * next chunk in turn, parse ahead into their share of pool and wait only to
+ * deliver. A non-zero return from fn stops all workers and is returned.
+ */
+int jr_lines_parallel(struct jr_lines *lines, struct jr pool[], int size,
+                      int nthreads, bool ordered, jr_lines_fn *fn, void *arg)
+{
+    if (nthreads < 1) return JR_INVAL;
+    if (size / nthreads < JR_SIZE_FOR(0)) return JR_NOMEM;
+
+    struct lines_shared shared = {0};
+    shared.length = lines->length - lines->pos;
+    shared.json = lines->json + lines->pos;
+    shared.nchunks = nthreads * 16;
+    shared.chunk = shared.length / shared.nchunks + 1;
+    shared.ordered = ordered;
+    shared.fn = fn;
+    shared.arg = arg;
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.cond, NULL);
+    shared.taken = 0;
+    shared.next = 0;
+    shared.stop = JR_OK;
+
+    struct lines_worker workers[nthreads];
+    bool started[nthreads];
+    for (int i = 0; i < nthreads; ++i)
+    {
+        struct lines_worker *w = &workers[i];
+        w->shared = &shared;
+        w->workers = workers;
+        w->id = i;
+        w->nworkers = nthreads;
+        pthread_mutex_init(&w->lock, NULL);
+        w->lo = shared.nchunks * i / nthreads;
+        w->hi = shared.nchunks * (i + 1) / nthreads;
+        w->size = size / nthreads;
+        w->pool = pool + w->size * i;
+    }
+
+    pthread_t threads[nthreads];
+    for (int i = 1; i < nthreads; ++i)
+    {
+        struct lines_worker *w = &workers[i];
+        started[i] = !pthread_create(&threads[i], NULL, lines_work, w);
+    }
+    lines_work(&workers[0]);
+    /* Chunks of a worker that failed to start have been stolen by now */
+    for (int i = 1; i < nthreads; ++i)
+    {
+        if (started[i]) pthread_join(threads[i], NULL);
+        else lines_work(&workers[i]);
+    }
+
+    for (int i = 0; i < nthreads; ++i)
+        pthread_mutex_destroy(&workers[i].lock);
+    pthread_cond_destroy(&shared.cond);
+    pthread_mutex_destroy(&shared.lock);
+    lines->pos = lines->length;
+    return shared.stop;
+}
+
+static void *lines_work(void *arg)
+{
+    struct lines_worker *w = arg;
+    int chunk = -1;
+    while ((chunk = lines_take(w)) >= 0)
+    {
+        if (w->shared->ordered) lines_chunk_ordered(w, chunk);
+        else lines_chunk(w, chunk);
+    }
+    return NULL;
+}
+
+/*
+ * Own chunks from the front, stolen ones from the back of another worker.
+ * Ordered mode deals them one at a time instead, so that the chunks being
+ * parsed are always the next ones to deliver.
+ */
+static int lines_take(struct lines_worker *w)
+{
+    struct lines_shared *s = w->shared;
+    pthread_mutex_lock(&s->lock);
+    int stop = s->stop;
+    int chunk = -1;
+    if (!stop && s->ordered && s->taken < s->nchunks) chunk = s->taken++;
+    pthread_mutex_unlock(&s->lock);
+    if (stop) return -1;
+    if (s->ordered) return chunk;
+
+    for (int i = 0; i < w->nworkers; ++i)
+    {
+        struct lines_worker *v = &w->workers[(w->id + i) % w->nworkers];
+        int chunk = -1;
+        pthread_mutex_lock(&v->lock);
+        if (v->lo < v->hi) chunk = v == w ? v->lo++ : --v->hi;
+        pthread_mutex_unlock(&v->lock);
+        if (chunk >= 0) return chunk;
+    }
+    return -1;
+}
+
+/* Start of the first record that begins at or after chunk * s->chunk */
+static int64_t lines_boundary(struct lines_shared const *s, int chunk)
+{
+    if (chunk <= 0) return 0;
+    if (chunk >= s->nchunks) return s->length;
+    int64_t at = chunk * s->chunk;
+    if (at >= s->length) return s->length;
+
+    char const *json = &s->json[at - 1];
+    char const *newline = memchr(json, '\n', (size_t)(s->length - (at - 1)));
+    return newline ? newline - s->json + 1 : s->length;
+}
+
+static void lines_chunk(struct lines_worker *w, int chunk)
+{
+    struct lines_shared *s = w->shared;
+    int64_t start = lines_boundary(s, chunk);
+    struct jr_lines lines = {0};
+    jr_lines_init(&lines, lines_boundary(s, chunk + 1) - start,
+                  s->json + start);
+
+    __jr_init(w->pool, w->size);
+    /* Other workers may have stopped: no record goes to fn after that */
+    while (!lines_stopped(s) && jr_lines_next(&lines, w->pool))
+    {
+        int rc = lines_deliver(s, w->pool, jr_error(), start + lines.start);
+        if (rc)
+        {
+            lines_stop(s, rc);
+            return;
+        }
+    }
+}
+
+static void lines_chunk_ordered(struct lines_worker *w, int chunk)
+{
+    struct lines_shared *s = w->shared;
+    int64_t start = lines_boundary(s, chunk);
+    struct jr_lines lines = {0};
+    jr_lines_init(&lines, lines_boundary(s, chunk + 1) - start,
+                  s->json + start);
+
+    bool turn = false;
+    int used = 0;
+    int npending = 0;
+    for (;;)
+    {
+        if (w->size - used < JR_SIZE_FOR(0) || npending == JR_LINES_BATCH)
+        {
+            if (!lines_flush(w, chunk, &turn, npending)) return;
+            used = npending = 0;
+        }
+        struct jr *jr = w->pool + used;
+        __jr_init(jr, w->size - used);
+        if (!jr_lines_next(&lines, jr)) break;
+
+        int rc = jr_error();
+        if (rc == JR_NOMEM && used > 0)
+        {
+            if (!lines_flush(w, chunk, &turn, npending)) return;
+            used = npending = 0;
+            jr = w->pool;
+            __jr_init(jr, w->size);
+            lines.pos = lines.start;
+            jr_lines_next(&lines, jr);
+            rc = jr_error();
+        }
+        w->pending[npending].offset = used;
+        w->pending[npending].rc = rc;
+        w->pending[npending].start = start + lines.start;
+        npending++;
+        used += lines_slots(jr, rc);
+    }
+    if (!lines_flush(w, chunk, &turn, npending)) return;
+
+    pthread_mutex_lock(&s->lock);
+    s->next = chunk + 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* Wait for the turn of chunk and deliver what has been parsed so far */
+static bool lines_flush(struct lines_worker *w, int chunk, bool *turn,
+                        int npending)
+{
+    struct lines_shared *s = w->shared;
+    if (!*turn)
+    {
+        pthread_mutex_lock(&s->lock);
+        while (!s->stop && s->next != chunk)
+            pthread_cond_wait(&s->cond, &s->lock);
+        *turn = !s->stop;
+        pthread_mutex_unlock(&s->lock);
+        if (!*turn) return false;
+    }
+
+    for (int i = 0; i < npending; ++i)
+    {
+        struct lines_pending const *p = &w->pending[i];
+        int rc = lines_deliver(s, w->pool + p->offset, p->rc, p->start);
+        if (rc)
+        {
+            lines_stop(s, rc);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int lines_deliver(struct lines_shared *s, struct jr jr[], int rc,
+                         int64_t start)
+{
+    /* Fresh cursor and error state, whatever was parsed in between */
+    if (rc == JR_OK) jr_reset(jr);
+    return s->fn(jr, rc, start, s->arg);
+}
+
+/* Entries of struct jr taken by a parsed record, sentinel included */
+static int lines_slots(struct jr const jr[], int rc)
+{
+    size_t nodes = jr[0].parser.toknext + (rc == JR_OK);
+    size_t bytes = nodes * sizeof(struct jr_node);
+    return __JR_HEADER +
+           (int)((bytes + sizeof(struct jr) - 1) / sizeof(struct jr));
+}
+
+/* Read before every record, so an atomic load where the compiler has one */
+static int lines_stopped(struct lines_shared *s)
+{
+#ifdef __GNUC__
+    return __atomic_load_n(&s->stop, __ATOMIC_ACQUIRE);
+#else
+    pthread_mutex_lock(&s->lock);
+    int stop = s->stop;
+    pthread_mutex_unlock(&s->lock);
+    return stop;
+#endif
+}
+
+static void lines_stop(struct lines_shared *s, int rc)
+{
+    pthread_mutex_lock(&s->lock);
+#ifdef __GNUC__
+    if (!s->stop) __atomic_store_n(&s->stop, rc, __ATOMIC_RELEASE);
+#else
+    if (!s->stop) s->stop = rc;
+#endif
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+/* meld-cut-here */
@@ -0,0 +1,23 @@
+#ifndef JR_LINES_H
+#define JR_LINES_H
+
+#include "jr.h"
+
+/* meld-cut-here */
+struct jr_lines
+{
+    int64_t length;
+    char *json;
+    int64_t pos;
+    int64_t start;
+};
+
+typedef int jr_lines_fn(struct jr[], int error, int64_t start, void *arg);
+
+void jr_lines_init(struct jr_lines *, int64_t length, char *json);
+bool jr_lines_next(struct jr_lines *, struct jr[]);
+int jr_lines_parallel(struct jr_lines *, struct jr pool[], int size,
+                      int nthreads, bool ordered, jr_lines_fn *, void *arg);
+/* meld-cut-here */
+
+#endif
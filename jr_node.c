@@ -3,15 +3,27 @@
 #include "jr_parser.h"
 
 /* meld-cut-here */
-struct jr_node *__jr_node_alloc(struct jr_parser *parser, int nnodes,
+struct jr_node *__jr_node_alloc(struct jr_parser *parser, jr_idx nnodes,
                                 struct jr_node *nodes)
 {
     if (parser->toknext >= nnodes) return NULL;
     struct jr_node *node = &nodes[parser->toknext++];
+    node->flags = 0;
     node->start = -1;
     node->end = -1;
     node->size = 0;
     node->parent = -1;
+    node->skip = parser->toknext;
+    node->hash = 0;
     return node;
 }
+
+/* FNV-1a, xor-folded to the 16 bits a node keeps */
+unsigned __jr_node_hash(jr_idx size, char const *str)
+{
+    uint32_t hash = 2166136261U;
+    for (jr_idx i = 0; i < size; ++i)
+        hash = (hash ^ (unsigned char)str[i]) * 16777619U;
+    return (hash >> 16) ^ (hash & 0xffff);
+}
 /* meld-cut-here */
@@ -1,21 +1,46 @@
 #ifndef JR_NODE_H
 #define JR_NODE_H
 
+#include "jr_idx.h"
+
 /* meld-cut-here */
+enum jr_node_flag
+{
+    JR_NODE_INTEGER = 1,
+    JR_NODE_NEGATIVE = 2, /* with JR_NODE_INTEGER */
+    JR_NODE_FLOAT = 4,
+    JR_NODE_CACHED = 8, /* decoded into jr_cache::values */
+    JR_NODE_ESCAPED = 16, /* string with at least one backslash */
+};
+
+/*
+ * The hash and select share a word with type and flags, so that a node is
+ * five indices plus four bytes: 24 bytes by default, 16 with 16-bit ones.
+ */
 struct jr_node
 {
-    int type;
-    int start;
-    int end;
-    int size;
-    int parent;
-    int prev;
+    union
+    {
+        uint16_t hash;   /* keys only, as folded by __jr_node_hash */
+        uint16_t select; /* containers of a projected parse */
+    };
+    unsigned char type;
+    unsigned char flags;
+    jr_idx start;
+    jr_idx end;
+    jr_idx size;
+    jr_idx parent;
+    jr_idx skip; /* one past the last descendant */
+#ifdef JR_BACK
+    jr_idx prev; /* where jr_back returns to */
+#endif
 };
 /* meld-cut-here */
 
 struct jr_parser;
 
-struct jr_node *__jr_node_alloc(struct jr_parser *parser, int nnodes,
+struct jr_node *__jr_node_alloc(struct jr_parser *parser, jr_idx nnodes,
                                 struct jr_node *nodes);
+unsigned __jr_node_hash(jr_idx size, char const *str);
 
 #endif
@@ -0,0 +1,362 @@
+#include "jr_number.h"
+#include "jr_error.h"
+
+/* meld-cut-here */
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define JR_NUMBER_SWAR
+#endif
+
+/* Doubles are exact up to here, which is what makes the fast path exact */
+#define NUMBER_EXACT_MAX (UINT64_C(1) << 53)
+
+static double const number_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int parse_integer(jr_idx size, char const *str, bool *negative,
+                         uint64_t *val);
+static int parse_integral(jr_idx size, char const *str, bool *negative,
+                          uint64_t *val);
+static int number_slow(jr_idx size, char const *str, double *val);
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/* Integers, and fractions or exponents that still make a whole number */
+extern int jr_number_long(jr_idx size, char const *str, long *val)
+{
+    bool negative = false;
+    uint64_t mag = 0;
+    int rc = parse_integer(size, str, &negative, &mag);
+    if (rc == JR_INVAL) rc = parse_integral(size, str, &negative, &mag);
+    *val = 0;
+    if (rc == JR_OUTRANGE) *val = negative ? LONG_MIN : LONG_MAX;
+    if (rc) return rc;
+
+    if (negative)
+    {
+        if (mag > (uint64_t)LONG_MAX + 1)
+        {
+            *val = LONG_MIN;
+            return JR_OUTRANGE;
+        }
+        *val = mag == (uint64_t)LONG_MAX + 1 ? LONG_MIN : -(long)mag;
+        return JR_OK;
+    }
+    if (mag > (uint64_t)LONG_MAX)
+    {
+        *val = LONG_MAX;
+        return JR_OUTRANGE;
+    }
+    *val = (long)mag;
+    return JR_OK;
+}
+
+extern int jr_number_ulong(jr_idx size, char const *str, unsigned long *val)
+{
+    bool negative = false;
+    uint64_t mag = 0;
+    int rc = parse_integer(size, str, &negative, &mag);
+    if (rc == JR_INVAL) rc = parse_integral(size, str, &negative, &mag);
+    *val = 0;
+    if (rc == JR_OUTRANGE && !negative) *val = ULONG_MAX;
+    if (rc) return rc;
+
+    if (negative && mag > 0) return JR_OUTRANGE;
+    if (mag > ULONG_MAX)
+    {
+        *val = ULONG_MAX;
+        return JR_OUTRANGE;
+    }
+    *val = (unsigned long)mag;
+    return JR_OK;
+}
+
+/*
+ * Up to 19 significant digits times an exactly representable power of ten
+ * is correctly rounded by a single multiplication or division (Clinger);
+ * anything else goes to strtod.
+ */
+extern int jr_number_double(jr_idx size, char const *str, double *val)
+{
+    char const *p = str;
+    char const *end = str + size;
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+
+    uint64_t mantissa = 0;
+    int ndigits = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    char const *digits = p;
+    for (; p < end && is_digit(*p); p++)
+    {
+        if (ndigits == 19)
+        {
+            truncated = true;
+            continue;
+        }
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        ndigits += mantissa > 0;
+    }
+    if (p == digits) goto invalid;
+
+    if (p < end && *p == '.')
+    {
+        digits = ++p;
+        for (; p < end && is_digit(*p); p++)
+        {
+            if (ndigits == 19)
+            {
+                truncated = true;
+                continue;
+            }
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            ndigits += mantissa > 0;
+            exponent--;
+        }
+        if (p == digits) goto invalid;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negexp = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        int exp = 0;
+        digits = p;
+        for (; p < end && is_digit(*p); p++)
+        {
+            if (exp < 100000) exp = exp * 10 + (*p - '0');
+        }
+        if (p == digits) goto invalid;
+        exponent += negexp ? -exp : exp;
+    }
+    if (p != end) goto invalid;
+
+    /* Any exponent leaves zero as it is */
+    if (mantissa == 0)
+    {
+        *val = negative ? -0.0 : 0.0;
+        return JR_OK;
+    }
+
+#if FLT_EVAL_METHOD == 0
+    if (!truncated && mantissa <= NUMBER_EXACT_MAX)
+    {
+        /* Move surplus powers of ten into the mantissa while it stays exact */
+        while (exponent > 22 && mantissa * 10 <= NUMBER_EXACT_MAX)
+        {
+            mantissa *= 10;
+            exponent--;
+        }
+        if (exponent >= -22 && exponent <= 22)
+        {
+            double d = (double)mantissa;
+            if (exponent < 0) d /= number_pow10[-exponent];
+            else d *= number_pow10[exponent];
+            *val = negative ? -d : d;
+            return JR_OK;
+        }
+    }
+#endif
+    return number_slow(size, str, val);
+
+invalid:
+    *val = 0;
+    return JR_INVAL;
+}
+
+/* Integers round once on the way to double; only overlong ones need strtod */
+extern int jr_number_integer_double(jr_idx size, char const *str, double *val)
+{
+    bool negative = false;
+    uint64_t mag = 0;
+    if (parse_integer(size, str, &negative, &mag))
+        return number_slow(size, str, val);
+    *val = negative ? -(double)mag : (double)mag;
+    return JR_OK;
+}
+
+#ifdef JR_NUMBER_SWAR
+static inline uint64_t load8(char const *p)
+{
+    uint64_t x = 0;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline bool eight_digits(uint64_t x)
+{
+    return ((x & UINT64_C(0xF0F0F0F0F0F0F0F0)) |
+            (((x + UINT64_C(0x0606060606060606)) &
+              UINT64_C(0xF0F0F0F0F0F0F0F0)) >>
+             4)) == UINT64_C(0x3333333333333333);
+}
+
+/* Value of eight ASCII digits, the first one in the lowest byte */
+static inline uint64_t eight_digits_value(uint64_t x)
+{
+    uint64_t const mask = UINT64_C(0x000000FF000000FF);
+    uint64_t const mul1 = UINT64_C(0x000F424000000064); /* 100, 1000000 */
+    uint64_t const mul2 = UINT64_C(0x0000271000000001); /* 1, 10000 */
+    x -= UINT64_C(0x3030303030303030);
+    x = (x * 10) + (x >> 8);
+    return (((x & mask) * mul1) + (((x >> 16) & mask) * mul2)) >> 32;
+}
+#endif
+
+/* Magnitude of [-]digits spanning exactly size bytes */
+static int parse_integer(jr_idx size, char const *str, bool *negative,
+                         uint64_t *val)
+{
+    char const *p = str;
+    char const *end = str + size;
+    *negative = p < end && *p == '-';
+    if (*negative) p++;
+    if (p == end) return JR_INVAL;
+
+    while (p + 1 < end && *p == '0')
+        p++;
+
+    char const *digits = p;
+    uint64_t v = 0;
+#ifdef JR_NUMBER_SWAR
+    /* Nineteen digits always fit, so only the scalar tail checks overflow */
+    while (end - p >= 8 && p - digits <= 11 && eight_digits(load8(p)))
+    {
+        v = v * 100000000 + eight_digits_value(load8(p));
+        p += 8;
+    }
+#endif
+    for (; p < end && is_digit(*p); p++)
+    {
+        uint64_t d = (uint64_t)(*p - '0');
+        if (p - digits >= 19 && (p - digits > 19 || v > (UINT64_MAX - d) / 10))
+            return JR_OUTRANGE;
+        v = v * 10 + d;
+    }
+    if (p != end || p == digits) return JR_INVAL;
+
+    *val = v;
+    return JR_OK;
+}
+
+/*
+ * Magnitude of a number with a fraction or an exponent whose value is whole,
+ * such as 1e2 or -1.0: the digits left after the point once the exponent is
+ * applied must all be zeros.
+ */
+static int parse_integral(jr_idx size, char const *str, bool *negative,
+                          uint64_t *val)
+{
+    char const *p = str;
+    char const *end = str + size;
+    *negative = p < end && *p == '-';
+    if (*negative) p++;
+
+    char const *digits = p;
+    while (p < end && is_digit(*p))
+        p++;
+    if (p == digits) return JR_INVAL;
+    int64_t ndigits = p - digits;
+    int64_t nfrac = 0;
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && is_digit(*p); p++)
+            nfrac++;
+        if (nfrac == 0) return JR_INVAL;
+    }
+    char const *last = p;
+
+    int64_t exponent = 0;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negexp = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        char const *start = p;
+        for (; p < end && is_digit(*p); p++)
+        {
+            if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+        }
+        if (p == start) return JR_INVAL;
+        if (negexp) exponent = -exponent;
+    }
+    if (p != end) return JR_INVAL;
+
+    int64_t shift = exponent - nfrac;
+    int64_t kept = ndigits + nfrac + (shift < 0 ? shift : 0);
+    uint64_t v = 0;
+    int64_t i = 0;
+    for (p = digits; p < last; p++)
+    {
+        if (*p == '.') continue;
+        uint64_t d = (uint64_t)(*p - '0');
+        if (i++ >= kept)
+        {
+            if (d) return JR_INVAL;
+            continue;
+        }
+        if (v > (UINT64_MAX - d) / 10) return JR_OUTRANGE;
+        v = v * 10 + d;
+    }
+    for (; shift > 0 && v > 0; shift--)
+    {
+        if (v > UINT64_MAX / 10) return JR_OUTRANGE;
+        v *= 10;
+    }
+
+    *val = v;
+    return JR_OK;
+}
+
+/*
+ * strtod on a terminated copy, with the locale's decimal point for JSON's.
+ * The point is taken from snprintf rather than localeconv, which is not
+ * safe to call while other threads parse.
+ */
+static int number_slow(jr_idx size, char const *str, double *val)
+{
+    char point[8] = ".";
+    char half[16];
+    int n = snprintf(half, sizeof(half), "%.1f", 0.5);
+    /* "0" and "5" around the point */
+    if (n >= 3 && n - 2 < (int)sizeof(point))
+    {
+        memcpy(point, half + 1, (size_t)n - 2);
+        point[n - 2] = '\0';
+    }
+
+    char buf[128];
+    size_t need = (size_t)size + strlen(point) + 1;
+    char *copy = need <= sizeof(buf) ? buf : malloc(need);
+    if (!copy) return JR_NOMEM;
+
+    char *dst = copy;
+    for (jr_idx i = 0; i < size; ++i)
+    {
+        if (str[i] != '.') *dst++ = str[i];
+        else dst += strlen(strcpy(dst, point));
+    }
+    *dst = '\0';
+
+    errno = 0;
+    *val = strtod(copy, NULL);
+    if (copy != buf) free(copy);
+    /* Subnormals also raise ERANGE but are still the correct value */
+    if (errno == ERANGE && (*val == 0 || *val == HUGE_VAL || *val == -HUGE_VAL))
+        return JR_OUTRANGE;
+    return JR_OK;
+}
+/* meld-cut-here */
@@ -0,0 +1,11 @@
+#ifndef JR_NUMBER_H
+#define JR_NUMBER_H
+
+#include "jr_idx.h"
+
+int jr_number_long(jr_idx size, char const *str, long *val);
+int jr_number_ulong(jr_idx size, char const *str, unsigned long *val);
+int jr_number_double(jr_idx size, char const *str, double *val);
+int jr_number_integer_double(jr_idx size, char const *str, double *val);
+
+#endif
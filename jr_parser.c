@@ -1,47 +1,130 @@
 #include "jr_parser.h"
 #include "jr_error.h"
 #include "jr_node.h"
+#include "jr_number.h"
+#include "jr_project.h"
+#include "jr_sax.h"
+#include "jr_scan.h"
 #include "jr_type.h"
+#include "jr_value.h"
 /* meld-cut-here */
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
-static int parse_primitive(struct jr_parser *parser, int length,
-                           char const *json, int num_tokens,
-                           struct jr_node *tokens);
-static int parse_string(struct jr_parser *parser, int len, const char *js,
-                        int nnodes, struct jr_node *nodes);
+/* Token cut short by the end of the input received so far */
+enum
+{
+    PARSE_PENDING = -1
+};
+
+/* Containers of a projected parse whose whole subtree is kept */
+#define SELECT_ALL UINT16_MAX
+
+/* Progress of a projected parse */
+struct project_state
+{
+    struct jr_project const *project;
+    char const *js;
+    uint64_t seen;
+    int done; /* depth to get back to once every path is seen, or 0 */
+};
+
+/* What jr_parser_sax expects next */
+enum validate_state
+{
+    VALIDATE_VALUE,
+    VALIDATE_KEY,
+    VALIDATE_NEXT,
+};
+
+static int parse_primitive(struct jr_parser *parser, jr_idx length,
+                           char const *json, jr_idx num_tokens,
+                           struct jr_node *tokens,
+                           struct jr_cache const *cache, bool complete);
+static int parse_string(struct jr_parser *parser, jr_idx len, const char *js,
+                        jr_idx nnodes, struct jr_node *nodes);
+static int string_token(struct jr_parser *parser, jr_idx len, const char *js,
+                        jr_idx nnodes, struct jr_node *nodes);
+static int pending(struct jr_parser *parser, jr_idx start, jr_idx pos);
 static int primitive_type(char c);
-static void fill_node(struct jr_node *token, const int type, const int start,
-                      const int end);
-static int open_bracket(char c, struct jr_parser *parser, int nnodes,
-                        struct jr_node *nodes);
-static int check_umatched(struct jr_parser *parser, struct jr_node *nodes);
+static int check_primitive(jr_idx size, char const *str, int *flags);
+static int check_literal(jr_idx size, char const *str, char const *literal);
+static int check_number(jr_idx size, char const *str, int *flags);
+static jr_idx skip_digits(jr_idx pos, jr_idx size, char const *str);
+static void cache_number(union jr_value *val, jr_idx size, char const *str,
+                         struct jr_node *node);
+static void fill_node(struct jr_node *token, const int type,
+                      const jr_idx start, const jr_idx end);
+static int open_bracket(char c, struct jr_parser *parser, jr_idx nnodes,
+                        struct jr_node *nodes, struct project_state const *);
 static int close_bracket(char c, struct jr_parser *parser,
                          struct jr_node *nodes);
+static bool after_key(struct jr_parser const *parser,
+                      struct jr_node const *nodes);
+static unsigned project_select(struct project_state const *, jr_idx super,
+                               struct jr_node const *nodes);
+static int project_match(struct jr_project const *, int parent,
+                         struct jr_node const *key, char const *js);
+static int project_key(struct jr_parser *parser, jr_idx len, char const *js,
+                       struct jr_node *nodes, struct project_state *);
+static int project_until(struct jr_parser const *parser,
+                         struct jr_node const *nodes, jr_idx object);
+static bool project_done(struct project_state const *,
+                         struct jr_parser const *parser);
+static int project_stop(struct jr_parser *parser, jr_idx len,
+                        struct jr_node *nodes);
+static jr_idx skip_value(jr_idx len, char const *js, jr_idx pos);
+static jr_idx skip_string(jr_idx len, char const *js, jr_idx pos);
+static int sax_emit(struct jr_sax *, jr_sax_fn *, void *arg, int event,
+                    jr_idx start, jr_idx end, int depth);
+static int sax_skip(jr_idx len, char const *js, jr_idx *pos, int *state);
+static int validate_string(jr_idx len, char const *js, jr_idx *pos);
+static int validate_primitive(jr_idx len, char const *js, jr_idx *pos);
+static jr_idx validate_escape(jr_idx size, char const *str);
+static jr_idx validate_utf8(jr_idx size, char const *str);
+static bool is_hex(char c);
 
-extern void jr_parser_init(struct jr_parser *parser, int alloc_size)
+extern void jr_parser_init(struct jr_parser *parser, jr_idx alloc_size)
 {
     parser->alloc_size = alloc_size;
-    parser->size = 0;
     parser->pos = 0;
     parser->toknext = 0;
     parser->toksuper = -1;
+    parser->tokstart = -1;
+    parser->depth = 0;
 }
 
 extern void jr_parser_reset(struct jr_parser *parser)
 {
-    parser->size = 0;
     parser->pos = 0;
     parser->toknext = 0;
     parser->toksuper = -1;
+    parser->tokstart = -1;
+    parser->depth = 0;
 }
 
-extern int jr_parser_parse(struct jr_parser *parser, const int len, char *js,
-                           int nnodes, struct jr_node *nodes)
+/*
+ * With a projection, members off its paths are skipped with neither key nor
+ * value nodes, and the input must be complete.
+ */
+extern int jr_parser_parse(struct jr_parser *parser, const jr_idx len,
+                           char *js, jr_idx nnodes, struct jr_node *nodes,
+                           struct jr_cache const *cache,
+                           struct jr_project const *project)
 {
     int rc = JR_OK;
-    parser->size = parser->toknext;
+    struct project_state state = {project, js, 0, 0};
+    struct project_state *ps = project ? &state : NULL;
+
+    if (parser->tokstart != -1)
+    {
+        rc = string_token(parser, len, js, nnodes, nodes);
+        if (rc) return rc == PARSE_PENDING ? JR_OK : rc;
+        parser->pos++;
+    }
 
     for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++)
     {
@@ -50,34 +133,38 @@ extern int jr_parser_parse(struct jr_parser *parser, const int len, char *js,
         {
         case '{':
         case '[':
-            parser->size++;
-            if ((rc = open_bracket(c, parser, nnodes, nodes))) return rc;
+            if ((rc = open_bracket(c, parser, nnodes, nodes, ps))) return rc;
             break;
         case '}':
         case ']':
+            if (project_done(ps, parser))
+                return project_stop(parser, len, nodes);
             if ((rc = close_bracket(c, parser, nodes))) return rc;
             break;
         case '\"':
-            if ((rc = parse_string(parser, len, js, nnodes, nodes))) return rc;
-            parser->size++;
-            if (parser->toksuper != -1 && nodes != NULL)
-            {
-                nodes[parser->toksuper].size++;
-            }
+            rc = string_token(parser, len, js, nnodes, nodes);
+            if (rc) return rc == PARSE_PENDING ? JR_OK : rc;
             break;
         case '\t':
         case '\r':
         case '\n':
         case ' ':
+            parser->pos = jr_scan_space(parser->pos, len, js) - 1;
             break;
         case ':':
+            /* Only after a key, which then tops the stack */
+            if (!after_key(parser, nodes)) return JR_INVAL;
             parser->toksuper = parser->toknext - 1;
+            if (ps && (rc = project_key(parser, len, js, nodes, ps))) return rc;
             break;
         case ',':
+            if (project_done(ps, parser))
+                return project_stop(parser, len, nodes);
             if (parser->toksuper != -1 &&
                 nodes[parser->toksuper].type != JR_ARRAY &&
                 nodes[parser->toksuper].type != JR_OBJECT)
             {
+                nodes[parser->toksuper].skip = parser->toknext;
                 parser->toksuper = nodes[parser->toksuper].parent;
             }
             break;
@@ -105,9 +192,9 @@ extern int jr_parser_parse(struct jr_parser *parser, const int len, char *js,
                     return JR_INVAL;
                 }
             }
-            if ((rc = parse_primitive(parser, len, js, nnodes, nodes)))
-                return rc;
-            parser->size++;
+            rc = parse_primitive(parser, len, js, nnodes, nodes, cache,
+                                 false);
+            if (rc) return rc == PARSE_PENDING ? JR_OK : rc;
             if (parser->toksuper != -1)
             {
                 nodes[parser->toksuper].size++;
@@ -120,15 +207,162 @@ extern int jr_parser_parse(struct jr_parser *parser, const int len, char *js,
         }
     }
 
-    if ((rc = check_umatched(parser, nodes))) return rc;
-
     return JR_OK;
 }
 
-static int parse_primitive(struct jr_parser *parser, int len, char const *js,
-                           int nnodes, struct jr_node *nodes)
+/*
+ * Read the top-level scalar left waiting for a delimiter, for input known
+ * to be complete: a JSON text on its own needs none.
+ */
+extern int jr_parser_end(struct jr_parser *parser, jr_idx len, char const *js,
+                         jr_idx nnodes, struct jr_node *nodes,
+                         struct jr_cache const *cache)
+{
+    if (parser->toknext != 0 || parser->tokstart != -1) return JR_OK;
+    if (parser->pos >= len || js[parser->pos] == '\0') return JR_OK;
+    int rc = parse_primitive(parser, len, js, nnodes, nodes, cache, true);
+    if (rc == JR_OK) parser->pos++;
+    return rc;
+}
+
+extern int jr_parser_finish(struct jr_parser *parser, jr_idx len,
+                            char const *js)
+{
+    /* The input ended in the middle of a token */
+    if (parser->tokstart != -1) return JR_INVAL;
+    if (parser->pos < len && js[parser->pos] != '\0') return JR_INVAL;
+
+    /* Some container is still open */
+    return parser->toksuper == -1 ? JR_OK : JR_INVAL;
+}
+
+/*
+ * Check js against RFC 8259 without building any node: tokens as
+ * jr_parser_parse reads them, commas and colons where they belong, a single
+ * top-level value and strings of valid UTF-8. Open containers take a bit
+ * each, so nesting is limited by JR_MAX_DEPTH alone. fn, if not NULL, is
+ * called with every token as soon as it is checked, and what it returns
+ * other than JR_OK or JR_SAX_SKIP ends the walk. *offset is set to where
+ * the walk ended early, or to len.
+ */
+extern int jr_parser_sax(jr_idx len, char const *js, jr_sax_fn *fn, void *arg,
+                         jr_idx *offset)
+{
+    unsigned char objects[(JR_MAX_DEPTH + 7) / 8] = {0};
+    struct jr_sax sax = {js, 0, 0, 0, 0};
+    int depth = 0;
+    int state = VALIDATE_VALUE;
+    jr_idx pos = 0;
+    int rc = JR_OK;
+
+    while (rc == JR_OK)
+    {
+        pos = jr_scan_space(pos, len, js);
+        if (state == VALIDATE_NEXT && depth == 0)
+        {
+            if (pos < len) rc = JR_INVAL;
+            break;
+        }
+        if (pos >= len)
+        {
+            rc = JR_INVAL;
+            break;
+        }
+
+        char c = js[pos];
+        jr_idx start = pos;
+        if (state == VALIDATE_KEY)
+        {
+            rc = c == '\"' ? validate_string(len, js, &pos) : JR_INVAL;
+            if (rc) break;
+            jr_idx end = pos - 1;
+            pos = jr_scan_space(pos, len, js);
+            if (pos >= len || js[pos] != ':')
+            {
+                rc = JR_INVAL;
+                break;
+            }
+            pos++;
+            state = VALIDATE_VALUE;
+            rc = sax_emit(&sax, fn, arg, JR_SAX_KEY, start + 1, end, depth);
+            if (rc == JR_SAX_SKIP) rc = sax_skip(len, js, &pos, &state);
+        }
+        else if (state == VALIDATE_NEXT)
+        {
+            bool object = objects[(depth - 1) / 8] >> ((depth - 1) % 8) & 1;
+            if (c == ',')
+            {
+                pos++;
+                state = object ? VALIDATE_KEY : VALIDATE_VALUE;
+            }
+            else if (c == (object ? '}' : ']'))
+            {
+                pos++;
+                depth--;
+                rc = sax_emit(&sax, fn, arg,
+                              object ? JR_SAX_OBJECT_END : JR_SAX_ARRAY_END,
+                              start, pos, depth);
+            }
+            else rc = JR_INVAL;
+        }
+        else if (c == '{' || c == '[')
+        {
+            if (depth == JR_MAX_DEPTH)
+            {
+                rc = JR_OUTRANGE;
+                break;
+            }
+            int event = c == '{' ? JR_SAX_OBJECT : JR_SAX_ARRAY;
+            rc = sax_emit(&sax, fn, arg, event, pos, pos + 1, depth);
+            if (rc == JR_SAX_SKIP)
+            {
+                rc = sax_skip(len, js, &pos, &state);
+                continue;
+            }
+            if (rc) break;
+
+            unsigned char bit = (unsigned char)(1U << (depth % 8));
+            if (c == '{') objects[depth / 8] |= bit;
+            else objects[depth / 8] &= (unsigned char)~bit;
+            depth++;
+
+            pos = jr_scan_space(pos + 1, len, js);
+            state = c == '{' ? VALIDATE_KEY : VALIDATE_VALUE;
+            if (pos < len && js[pos] == (c == '{' ? '}' : ']'))
+            {
+                pos++;
+                depth--;
+                state = VALIDATE_NEXT;
+                rc = sax_emit(&sax, fn, arg, event + 1, pos - 1, pos, depth);
+            }
+        }
+        else
+        {
+            int event = JR_SAX_STRING;
+            if (c == '\"') rc = validate_string(len, js, &pos);
+            else rc = validate_primitive(len, js, &pos);
+            state = VALIDATE_NEXT;
+            if (rc) break;
+
+            if (c == 't' || c == 'f') event = JR_SAX_BOOL;
+            else if (c == 'n') event = JR_SAX_NULL;
+            else if (c != '\"') event = JR_SAX_NUMBER;
+            if (event == JR_SAX_STRING)
+                rc = sax_emit(&sax, fn, arg, event, start + 1, pos - 1, depth);
+            else rc = sax_emit(&sax, fn, arg, event, start, pos, depth);
+        }
+    }
+    *offset = rc ? pos : len;
+    return rc;
+}
+
+/* With complete set, the end of the input also ends the primitive */
+static int parse_primitive(struct jr_parser *parser, jr_idx len,
+                           char const *js, jr_idx nnodes,
+                           struct jr_node *nodes, struct jr_cache const *cache,
+                           bool complete)
 {
-    int start = parser->pos;
+    jr_idx start = parser->pos;
 
     for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++)
     {
@@ -152,11 +386,23 @@ static int parse_primitive(struct jr_parser *parser, int len, char const *js,
             return JR_INVAL;
         }
     }
+    if (complete) goto found;
+    /* The delimiter might still be on its way */
+    if (parser->pos >= len) return pending(parser, -1, start);
+
     /* In strict mode primitive must be followed by a comma/object/array */
     parser->pos = start;
     return JR_INVAL;
 
 found:;
+    int flags = 0;
+    int rc = check_primitive(parser->pos - start, js + start, &flags);
+    if (rc)
+    {
+        parser->pos = start;
+        return rc;
+    }
+
     struct jr_node *node = __jr_node_alloc(parser, nnodes, nodes);
     if (node == NULL)
     {
@@ -164,32 +410,38 @@ found:;
         return JR_NOMEM;
     }
     fill_node(node, primitive_type(js[start]), start, parser->pos);
+    node->flags = flags;
+    if (flags && parser->toknext <= cache->size)
+        cache_number(&cache->values[parser->toknext - 1], parser->pos - start,
+                     js + start, node);
     node->parent = parser->toksuper;
     parser->pos--;
     return JR_OK;
 }
 
-static int parse_string(struct jr_parser *parser, int len, const char *js,
-                        int nnodes, struct jr_node *nodes)
+static int parse_string(struct jr_parser *parser, jr_idx len, const char *js,
+                        jr_idx nnodes, struct jr_node *nodes)
 {
     struct jr_node *token;
 
-    int start = parser->pos;
-
-    /* Skip starting quote */
-    parser->pos++;
+    /* Either resume a pending string or skip the starting quote */
+    jr_idx start = parser->tokstart;
+    if (start == -1) start = parser->pos++;
+    parser->tokstart = -1;
+    /* A resumed string may have seen its backslashes in an earlier chunk */
+    jr_idx seen = parser->pos - start - 1;
+    bool escaped = memchr(js + start + 1, '\\', (size_t)seen) != NULL;
 
-    for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++)
+    for (; parser->pos < len; parser->pos++)
     {
+        /* Jump over the plain run up to the next quote or backslash */
+        parser->pos = jr_scan_string(parser->pos, len, js);
+        if (parser->pos >= len || js[parser->pos] == '\0') break;
         char c = js[parser->pos];
 
         /* Quote: end of string */
         if (c == '\"')
         {
-            if (nodes == NULL)
-            {
-                return JR_OK;
-            }
             token = __jr_node_alloc(parser, nnodes, nodes);
             if (token == NULL)
             {
@@ -197,58 +449,183 @@ static int parse_string(struct jr_parser *parser, int len, const char *js,
                 return JR_NOMEM;
             }
             fill_node(token, JR_STRING, start + 1, parser->pos);
+            if (escaped) token->flags |= JR_NODE_ESCAPED;
             token->parent = parser->toksuper;
+            if (parser->toksuper != -1 &&
+                nodes[parser->toksuper].type == JR_OBJECT)
+            {
+                token->hash =
+                    __jr_node_hash(parser->pos - start - 1, js + start + 1);
+            }
             return JR_OK;
         }
 
         /* Backslash: Quoted symbol expected */
-        if (c == '\\' && parser->pos + 1 < len)
+        jr_idx escape = parser->pos++;
+        escaped = true;
+        if (parser->pos >= len) return pending(parser, start, escape);
+        int i;
+        switch (js[parser->pos])
         {
-            int i;
+        /* Allowed escaped symbols */
+        case '\"':
+        case '/':
+        case '\\':
+        case 'b':
+        case 'f':
+        case 'r':
+        case 'n':
+        case 't':
+            break;
+        /* Allows escaped symbol \uXXXX */
+        case 'u':
             parser->pos++;
-            switch (js[parser->pos])
+            for (i = 0; i < 4 && parser->pos < len && js[parser->pos] != '\0';
+                 i++)
             {
-            /* Allowed escaped symbols */
-            case '\"':
-            case '/':
-            case '\\':
-            case 'b':
-            case 'f':
-            case 'r':
-            case 'n':
-            case 't':
-                break;
-            /* Allows escaped symbol \uXXXX */
-            case 'u':
-                parser->pos++;
-                for (i = 0;
-                     i < 4 && parser->pos < len && js[parser->pos] != '\0'; i++)
-                {
-                    /* If it isn't a hex character we have an error */
-                    if (!((js[parser->pos] >= 48 &&
-                           js[parser->pos] <= 57) || /* 0-9 */
-                          (js[parser->pos] >= 65 &&
-                           js[parser->pos] <= 70) || /* A-F */
-                          (js[parser->pos] >= 97 && js[parser->pos] <= 102)))
-                    { /* a-f */
-                        parser->pos = start;
-                        return JR_INVAL;
-                    }
-                    parser->pos++;
+                /* If it isn't a hex character we have an error */
+                if (!((js[parser->pos] >= 48 &&
+                       js[parser->pos] <= 57) || /* 0-9 */
+                      (js[parser->pos] >= 65 &&
+                       js[parser->pos] <= 70) || /* A-F */
+                      (js[parser->pos] >= 97 && js[parser->pos] <= 102)))
+                { /* a-f */
+                    parser->pos = start;
+                    return JR_INVAL;
                 }
-                parser->pos--;
-                break;
-            /* Unexpected symbol */
-            default:
-                parser->pos = start;
-                return JR_INVAL;
+                parser->pos++;
             }
+            if (parser->pos >= len) return pending(parser, start, escape);
+            parser->pos--;
+            break;
+        /* Unexpected symbol */
+        default:
+            parser->pos = start;
+            return JR_INVAL;
         }
     }
+    if (parser->pos >= len) return pending(parser, start, parser->pos);
     parser->pos = start;
     return JR_INVAL;
 }
 
+static int string_token(struct jr_parser *parser, jr_idx len, const char *js,
+                        jr_idx nnodes, struct jr_node *nodes)
+{
+    int rc = parse_string(parser, len, js, nnodes, nodes);
+    if (rc) return rc;
+    if (parser->toksuper != -1)
+    {
+        nodes[parser->toksuper].size++;
+    }
+    return JR_OK;
+}
+
+/* Park the parser on a token that the next chunk has to complete */
+static int pending(struct jr_parser *parser, jr_idx start, jr_idx pos)
+{
+    parser->tokstart = start;
+    parser->pos = pos;
+    return PARSE_PENDING;
+}
+
+/* From the opening quote at *pos to past the closing one, or to the error */
+static int validate_string(jr_idx len, char const *js, jr_idx *pos)
+{
+    jr_idx at = *pos + 1;
+    int rc = JR_INVAL;
+    while ((at = jr_scan_text(at, len, js)) < len)
+    {
+        unsigned char c = (unsigned char)js[at];
+        jr_idx n = 0;
+        if (c == '\"')
+        {
+            rc = JR_OK;
+            at++;
+            break;
+        }
+        if (c == '\\') n = validate_escape(len - at, js + at);
+        else if (c >= 0x80) n = validate_utf8(len - at, js + at);
+        /* Control characters must be escaped */
+        if (n == 0) break;
+        at += n;
+    }
+    *pos = at;
+    return rc;
+}
+
+static int validate_primitive(jr_idx len, char const *js, jr_idx *pos)
+{
+    jr_idx end = *pos;
+    for (; end < len; ++end)
+    {
+        char c = js[end];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+              (c >= 'A' && c <= 'Z') || c == '+' || c == '-' || c == '.'))
+            break;
+    }
+    if (end == *pos) return JR_INVAL;
+
+    int flags = 0;
+    int rc = check_primitive(end - *pos, js + *pos, &flags);
+    if (rc == JR_OK) *pos = end;
+    return rc;
+}
+
+/* Length of the escape sequence at str, or 0 if it is not one */
+static jr_idx validate_escape(jr_idx size, char const *str)
+{
+    if (size < 2) return 0;
+    switch (str[1])
+    {
+    case '\"':
+    case '/':
+    case '\\':
+    case 'b':
+    case 'f':
+    case 'r':
+    case 'n':
+    case 't':
+        return 2;
+    case 'u':
+        if (size < 6) return 0;
+        for (int i = 2; i < 6; ++i)
+            if (!is_hex(str[i])) return 0;
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+/* Length of the UTF-8 sequence at str, or 0 if it is ill-formed (RFC 3629) */
+static jr_idx validate_utf8(jr_idx size, char const *str)
+{
+    unsigned char const *s = (unsigned char const *)str;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+    jr_idx n = 0;
+    if (s[0] >= 0xC2 && s[0] <= 0xDF) n = 2;
+    else if (s[0] >= 0xE0 && s[0] <= 0xEF) n = 3;
+    else if (s[0] >= 0xF0 && s[0] <= 0xF4) n = 4;
+    if (n == 0 || size < n) return 0;
+
+    /* No overlong forms, surrogates or code points past U+10FFFF */
+    if (s[0] == 0xE0) lo = 0xA0;
+    if (s[0] == 0xED) hi = 0x9F;
+    if (s[0] == 0xF0) lo = 0x90;
+    if (s[0] == 0xF4) hi = 0x8F;
+    if (s[1] < lo || s[1] > hi) return 0;
+    for (jr_idx i = 2; i < n; ++i)
+        if ((s[i] & 0xC0) != 0x80) return 0;
+    return n;
+}
+
+static bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') ||
+           (c >= 'a' && c <= 'f');
+}
+
 static int primitive_type(char c)
 {
     switch (c)
@@ -279,8 +656,88 @@ static int primitive_type(char c)
     return 0;
 }
 
-static void fill_node(struct jr_node *token, const int type, const int start,
-                      const int end)
+static int check_primitive(jr_idx size, char const *str, int *flags)
+{
+    switch (str[0])
+    {
+    case 't':
+        return check_literal(size, str, "true");
+    case 'f':
+        return check_literal(size, str, "false");
+    case 'n':
+        return check_literal(size, str, "null");
+    default:
+        return check_number(size, str, flags);
+    }
+}
+
+static int check_literal(jr_idx size, char const *str, char const *literal)
+{
+    jr_idx i = 0;
+    for (; i < size && literal[i]; ++i)
+        if (str[i] != literal[i]) return JR_INVAL;
+    return i == size && !literal[i] ? JR_OK : JR_INVAL;
+}
+
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? over exactly size bytes */
+static int check_number(jr_idx size, char const *str, int *flags)
+{
+    jr_idx pos = 0;
+    jr_idx end = 0;
+    *flags = JR_NODE_INTEGER;
+    if (str[pos] == '-')
+    {
+        *flags |= JR_NODE_NEGATIVE;
+        pos++;
+    }
+
+    if (pos < size && str[pos] == '0') end = pos + 1;
+    else end = skip_digits(pos, size, str);
+    if (end == pos) return JR_INVAL;
+    pos = end;
+
+    if (pos < size && str[pos] == '.')
+    {
+        end = skip_digits(++pos, size, str);
+        if (end == pos) return JR_INVAL;
+        pos = end;
+        *flags = JR_NODE_FLOAT;
+    }
+
+    if (pos < size && (str[pos] == 'e' || str[pos] == 'E'))
+    {
+        pos++;
+        if (pos < size && (str[pos] == '+' || str[pos] == '-')) pos++;
+        end = skip_digits(pos, size, str);
+        if (end == pos) return JR_INVAL;
+        pos = end;
+        *flags = JR_NODE_FLOAT;
+    }
+
+    return pos == size ? JR_OK : JR_INVAL;
+}
+
+static jr_idx skip_digits(jr_idx pos, jr_idx size, char const *str)
+{
+    while (pos < size && str[pos] >= '0' && str[pos] <= '9')
+        pos++;
+    return pos;
+}
+
+/* Numbers that fail to decode stay lazy and report their error on access */
+static void cache_number(union jr_value *val, jr_idx size, char const *str,
+                         struct jr_node *node)
+{
+    int rc = JR_OK;
+    if (node->flags & JR_NODE_FLOAT)
+        rc = jr_number_double(size, str, &val->real);
+    else
+        rc = jr_number_long(size, str, &val->integer);
+    if (rc == JR_OK) node->flags |= JR_NODE_CACHED;
+}
+
+static void fill_node(struct jr_node *token, const int type,
+                      const jr_idx start, const jr_idx end)
 {
     token->type = type;
     token->start = start;
@@ -288,9 +745,10 @@ static void fill_node(struct jr_node *token, const int type, const int start,
     token->size = 0;
 }
 
-static int open_bracket(char c, struct jr_parser *parser, int nnodes,
-                        struct jr_node *nodes)
+static int open_bracket(char c, struct jr_parser *parser, jr_idx nnodes,
+                        struct jr_node *nodes, struct project_state const *ps)
 {
+    if (parser->depth >= JR_MAX_DEPTH) return JR_OUTRANGE;
     struct jr_node *node = __jr_node_alloc(parser, nnodes, nodes);
     if (node == NULL) return JR_NOMEM;
     if (parser->toksuper != -1)
@@ -305,52 +763,227 @@ static int open_bracket(char c, struct jr_parser *parser, int nnodes,
         node->parent = parser->toksuper;
     }
     node->type = (c == '{' ? JR_OBJECT : JR_ARRAY);
+    parser->depth++;
+    if (ps) node->select = project_select(ps, parser->toksuper, nodes);
     node->start = parser->pos;
     parser->toksuper = parser->toknext - 1;
     return JR_OK;
 }
 
-static int check_umatched(struct jr_parser *parser, struct jr_node *nodes)
+/*
+ * What a new container under super keeps: everything, or the keys that are
+ * children of select - 1 in the projection, where -1 is the top level.
+ */
+static unsigned project_select(struct project_state const *ps, jr_idx super,
+                               struct jr_node const *nodes)
+{
+    if (super == -1) return 0;
+    struct jr_node const *node = &nodes[super];
+    if (node->type == JR_ARRAY) return node->select;
+    if (node->type != JR_STRING) return SELECT_ALL;
+
+    unsigned select = nodes[node->parent].select;
+    if (select == SELECT_ALL) return SELECT_ALL;
+    int i = project_match(ps->project, (int)select - 1, node, ps->js);
+    if (i == -1 || ps->project->select[i].path != -1) return SELECT_ALL;
+    return (unsigned)i + 1;
+}
+
+static int project_match(struct jr_project const *project, int parent,
+                         struct jr_node const *key, char const *js)
 {
-    for (int i = parser->toknext - 1; i >= 0; i--)
+    jr_idx size = key->end - key->start;
+    for (int i = 0; i < project->count; ++i)
     {
-        /* Unmatched opened object or array */
-        if (nodes[i].start != -1 && nodes[i].end == -1) return JR_INVAL;
+        struct jr_select const *s = &project->select[i];
+        if (s->parent != parent || s->hash != key->hash) continue;
+        if (s->size == size && !memcmp(s->key, js + key->start, size))
+            return i;
     }
+    return -1;
+}
+
+/* The key on top of the stack is kept, or dropped along with its value */
+static int project_key(struct jr_parser *parser, jr_idx len, char const *js,
+                       struct jr_node *nodes, struct project_state *ps)
+{
+    struct jr_node const *key = &nodes[parser->toksuper];
+    jr_idx object = key->parent;
+    unsigned select = nodes[object].select;
+    if (select == SELECT_ALL) return JR_OK;
+
+    struct jr_project const *project = ps->project;
+    int i = project_match(project, (int)select - 1, key, js);
+    if (i != -1)
+    {
+        int path = project->select[i].path;
+        if (path == -1) return JR_OK;
+        ps->seen |= (uint64_t)1 << path;
+        uint64_t all = ~(uint64_t)0 >> (64 - project->npaths);
+        if (project->stop && !ps->done && ps->seen == all)
+            ps->done = project_until(parser, nodes, object);
+        return JR_OK;
+    }
+
+    jr_idx end = skip_value(len, js, parser->pos + 1);
+    if (end == -1) return JR_INVAL;
+    parser->pos = end - 1;
+    parser->toknext--;
+    parser->toksuper = object;
+    nodes[object].size--;
     return JR_OK;
 }
 
-static int close_bracket(char c, struct jr_parser *parser,
-                         struct jr_node *nodes)
+/*
+ * Depth back at which a parse with every path seen can stop: past the value
+ * of the last key, or past the outermost array around it, whose later
+ * elements can match again. 0, never, when that array is the top level.
+ */
+static int project_until(struct jr_parser const *parser,
+                         struct jr_node const *nodes, jr_idx object)
 {
-    int type = (c == '}' ? JR_OBJECT : JR_ARRAY);
-    if (parser->toknext < 1)
+    int depth = parser->depth;
+    int until = depth;
+    for (jr_idx i = object; i != -1; i = nodes[i].parent)
     {
-        return JR_INVAL;
+        if (nodes[i].type == JR_STRING) continue;
+        if (nodes[i].type == JR_ARRAY) until = depth - 1;
+        depth--;
     }
-    struct jr_node *node = &nodes[parser->toknext - 1];
-    for (;;)
+    return until;
+}
+
+/* At a comma or a closing bracket past the value that completed the paths */
+static bool project_done(struct project_state const *ps,
+                         struct jr_parser const *parser)
+{
+    if (!ps || !ps->done) return false;
+    return parser->depth <= ps->done;
+}
+
+/* Close whatever is still open, as if the input ended here */
+static int project_stop(struct jr_parser *parser, jr_idx len,
+                        struct jr_node *nodes)
+{
+    for (jr_idx i = parser->toksuper; i != -1; i = nodes[i].parent)
     {
-        if (node->start != -1 && node->end == -1)
+        nodes[i].skip = parser->toknext;
+        if (nodes[i].end == -1) nodes[i].end = parser->pos;
+    }
+    parser->toksuper = -1;
+    parser->depth = 0;
+    parser->pos = len;
+    return JR_OK;
+}
+
+/*
+ * One past the value at or after pos, or -1 if it is cut. Only quotes and
+ * brackets are looked at: what is skipped is not validated.
+ */
+static jr_idx skip_value(jr_idx len, char const *js, jr_idx pos)
+{
+    int depth = 0;
+    pos = jr_scan_space(pos, len, js);
+    do
+    {
+        if (pos >= len || js[pos] == '\0') return -1;
+        switch (js[pos])
         {
-            if (node->type != type)
-            {
-                return JR_INVAL;
-            }
-            node->end = parser->pos + 1;
-            parser->toksuper = node->parent;
+        case '\"':
+            if ((pos = skip_string(len, js, pos)) == -1) return -1;
             break;
-        }
-        if (node->parent == -1)
-        {
-            if (node->type != type || parser->toksuper == -1)
+        case '{':
+        case '[':
+            depth++;
+            pos++;
+            break;
+        case '}':
+        case ']':
+            if (depth-- == 0) return -1;
+            pos++;
+            break;
+        default:
+            if (depth > 0)
             {
-                return JR_INVAL;
+                pos++;
+                break;
             }
-            break;
+            /* A primitive ends at the next delimiter */
+            while (pos < len && !strchr(" \t\r\n,]}", js[pos]))
+                pos++;
+            if (pos >= len) return -1;
         }
+    } while (depth > 0);
+    return pos;
+}
+
+static int sax_emit(struct jr_sax *sax, jr_sax_fn *fn, void *arg, int event,
+                    jr_idx start, jr_idx end, int depth)
+{
+    if (!fn) return JR_OK;
+    sax->event = event;
+    sax->start = start;
+    sax->end = end;
+    sax->depth = depth;
+    int rc = fn(sax, arg);
+    /* Only containers and keys have something to skip */
+    if (rc == JR_SAX_SKIP && event != JR_SAX_OBJECT && event != JR_SAX_ARRAY &&
+        event != JR_SAX_KEY)
+        return JR_OK;
+    return rc;
+}
+
+/* Jump over the value at *pos, which is then only checked for balance */
+static int sax_skip(jr_idx len, char const *js, jr_idx *pos, int *state)
+{
+    jr_idx end = skip_value(len, js, *pos);
+    if (end == -1) return JR_INVAL;
+    *pos = end;
+    *state = VALIDATE_NEXT;
+    return JR_OK;
+}
+
+static jr_idx skip_string(jr_idx len, char const *js, jr_idx pos)
+{
+    for (pos++; (pos = jr_scan_string(pos, len, js)) < len; pos += 2)
+    {
+        if (js[pos] == '\"') return pos + 1;
+        if (js[pos] == '\0') return -1;
+    }
+    return -1;
+}
+
+static bool after_key(struct jr_parser const *parser,
+                      struct jr_node const *nodes)
+{
+    jr_idx super = parser->toksuper;
+    if (super == -1 || nodes[super].type != JR_OBJECT) return false;
+    struct jr_node const *key = &nodes[parser->toknext - 1];
+    return key->type == JR_STRING && key->parent == super;
+}
+
+/*
+ * The container to close is on top of the stack, or right under the key of
+ * its last member. Everything in between was closed with its skip set.
+ */
+static int close_bracket(char c, struct jr_parser *parser,
+                         struct jr_node *nodes)
+{
+    int type = (c == '}' ? JR_OBJECT : JR_ARRAY);
+    if (parser->toksuper == -1) return JR_INVAL;
+
+    struct jr_node *node = &nodes[parser->toksuper];
+    if (node->type != JR_OBJECT && node->type != JR_ARRAY)
+    {
+        node->skip = parser->toknext;
+        if (node->parent == -1) return JR_INVAL;
         node = &nodes[node->parent];
     }
+    if (node->type != type) return JR_INVAL;
+    node->skip = parser->toknext;
+    node->end = parser->pos + 1;
+    parser->toksuper = node->parent;
+    parser->depth--;
     return JR_OK;
 }
 /* meld-cut-here */
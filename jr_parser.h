@@ -1,16 +1,31 @@
 #ifndef JR_PARSER_H
 #define JR_PARSER_H
 
+#include "jr_idx.h"
 #include <stddef.h>
 
 /* meld-cut-here */
+/* Deeper nesting fails to parse with JR_OUTRANGE */
+#ifndef JR_MAX_DEPTH
+#define JR_MAX_DEPTH 1024
+#endif
+
+#if JR_MAX_DEPTH < 1 || JR_MAX_DEPTH > 65535
+#error "JR_MAX_DEPTH must be between 1 and 65535"
+#endif
+
+/*
+ * The open containers form a stack through toksuper, the innermost one or
+ * the key of its last member, and their parent links.
+ */
 struct jr_parser
 {
-    int alloc_size;
-    int size;
-    int pos;
-    int toknext;
-    int toksuper;
+    jr_idx alloc_size;
+    jr_idx pos;
+    jr_idx toknext; /* also the node count once parsed */
+    jr_idx toksuper;
+    jr_idx tokstart;
+    unsigned short depth; /* containers open at pos */
 };
 /* meld-cut-here */
 
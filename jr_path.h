@@ -0,0 +1,42 @@
+#ifndef JR_PATH_H
+#define JR_PATH_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+struct jr_iter;
+
+enum jr_step_kind
+{
+    JR_STEP_KEY,
+    JR_STEP_INDEX,
+    JR_STEP_ANY,
+    JR_STEP_SLICE,
+};
+
+/*
+ * One step of a compiled path. A key step also carries the index of a JSON
+ * Pointer token made of digits, or -1, for when it meets an array.
+ */
+struct jr_step
+{
+    int kind;
+    char const *key;
+    jr_idx size;
+    unsigned hash;
+    jr_idx start; /* index of JR_STEP_INDEX, or start of JR_STEP_SLICE */
+    jr_idx stop;
+    jr_idx stride;
+};
+
+struct jr_path
+{
+    int size;
+    int count;
+    struct jr_step *step;
+};
+
+typedef int jr_path_fn(struct jr_iter *, void *arg);
+/* meld-cut-here */
+
+#endif
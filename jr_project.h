@@ -0,0 +1,39 @@
+#ifndef JR_PROJECT_H
+#define JR_PROJECT_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+#include <stdbool.h>
+
+/* One key of the paths of a projection, children after their parent */
+struct jr_select
+{
+    char const *key;
+    jr_idx size;
+    unsigned hash;
+    int parent; /* -1 for the keys of the top-level container */
+    int path;   /* index of the path that ends here, or -1 */
+};
+
+/*
+ * Parsing keeps a bit per path to know when every one has been seen, and a
+ * 16-bit select per container.
+ */
+enum
+{
+    JR_PROJECT_MAX_PATHS = 64,
+    JR_PROJECT_MAX_KEYS = 65534
+};
+
+struct jr_project
+{
+    int size;
+    int count;
+    int npaths;
+    bool stop;
+    struct jr_select *select;
+};
+/* meld-cut-here */
+
+#endif
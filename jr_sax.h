@@ -0,0 +1,42 @@
+#ifndef JR_SAX_H
+#define JR_SAX_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+enum jr_sax_event
+{
+    JR_SAX_OBJECT,
+    JR_SAX_OBJECT_END,
+    JR_SAX_ARRAY,
+    JR_SAX_ARRAY_END,
+    JR_SAX_KEY,
+    JR_SAX_STRING,
+    JR_SAX_NUMBER,
+    JR_SAX_BOOL,
+    JR_SAX_NULL,
+};
+
+/* Returned by a callback to leave out what the event opens */
+enum
+{
+    JR_SAX_SKIP = -1
+};
+
+/*
+ * The token at [start, end) of json: the body of strings and keys, still
+ * escaped, the bracket of containers and the text of primitives.
+ */
+struct jr_sax
+{
+    char const *json;
+    int event;
+    jr_idx start;
+    jr_idx end;
+    int depth;
+};
+
+typedef int jr_sax_fn(struct jr_sax const *, void *arg);
+/* meld-cut-here */
+
+#endif
@@ -0,0 +1,426 @@
+#include "jr_scan.h"
+
+/* meld-cut-here */
+#if !defined(JR_NO_SIMD) && defined(__GNUC__) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define JR_SCAN_X86
+#include <immintrin.h>
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+
+enum scan_level
+{
+    SCAN_UNKNOWN = 0,
+    SCAN_SCALAR = 1,
+    SCAN_SSE2 = 2,
+    SCAN_AVX2 = 3,
+};
+
+#ifdef JR_SCAN_X86
+/* Detected on first use; threads racing there all store the same value. */
+static int scan_cached = SCAN_UNKNOWN;
+#endif
+
+/* Node counting carries these across 64-byte blocks */
+struct count_state
+{
+    jr_idx count;
+    bool string;
+    bool escape;
+    bool primitive;
+};
+
+/* One bit per byte of a 64-byte block */
+struct count_block
+{
+    uint64_t quote;
+    uint64_t open;
+    uint64_t other;
+    uint64_t slow; /* backslashes and NULs, left to the scalar count */
+};
+
+static int scan_detect(void);
+static inline int scan_level(void);
+static inline int scan_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+static jr_idx string_scalar(jr_idx pos, jr_idx len, char const *js);
+static jr_idx text_scalar(jr_idx pos, jr_idx len, char const *js);
+static jr_idx space_scalar(jr_idx pos, jr_idx len, char const *js);
+static bool count_scalar(struct count_state *, jr_idx len, char const *js);
+#ifdef JR_SCAN_X86
+static jr_idx count_wide(struct count_state *, jr_idx len, char const *js);
+static void count_masks(struct count_state *, struct count_block const *);
+static void block_sse2(char const *js, struct count_block *);
+static void block_avx2(char const *js, struct count_block *);
+static jr_idx string_sse2(jr_idx pos, jr_idx len, char const *js);
+static jr_idx string_avx2(jr_idx pos, jr_idx len, char const *js);
+static jr_idx text_sse2(jr_idx pos, jr_idx len, char const *js);
+static jr_idx text_avx2(jr_idx pos, jr_idx len, char const *js);
+static jr_idx space_sse2(jr_idx pos, jr_idx len, char const *js);
+static jr_idx space_avx2(jr_idx pos, jr_idx len, char const *js);
+#endif
+
+/* Index of the first quote, backslash or NUL at or after pos, or len. */
+extern jr_idx jr_scan_string(jr_idx pos, jr_idx len, char const *js)
+{
+#ifdef JR_SCAN_X86
+    int level = scan_level();
+    if (level == SCAN_AVX2) return string_avx2(pos, len, js);
+    if (level == SCAN_SSE2) return string_sse2(pos, len, js);
+#endif
+    return string_scalar(pos, len, js);
+}
+
+/*
+ * Index of the first quote, backslash, control character or non-ASCII byte
+ * at or after pos, or len: the plain run of a string that needs no check.
+ */
+extern jr_idx jr_scan_text(jr_idx pos, jr_idx len, char const *js)
+{
+#ifdef JR_SCAN_X86
+    int level = scan_level();
+    if (level == SCAN_AVX2) return text_avx2(pos, len, js);
+    if (level == SCAN_SSE2) return text_sse2(pos, len, js);
+#endif
+    return text_scalar(pos, len, js);
+}
+
+/* Index of the first non-whitespace byte at or after pos, or len. */
+extern jr_idx jr_scan_space(jr_idx pos, jr_idx len, char const *js)
+{
+    /* Single separators are the common case: no need to go wide. */
+    if (pos + 1 >= len || !scan_is_space(js[pos + 1]))
+        return space_scalar(pos, len, js);
+#ifdef JR_SCAN_X86
+    int level = scan_level();
+    if (level == SCAN_AVX2) return space_avx2(pos, len, js);
+    if (level == SCAN_SSE2) return space_sse2(pos, len, js);
+#endif
+    return space_scalar(pos, len, js);
+}
+
+/*
+ * Nodes in the first len bytes of js, which is exact for valid JSON: opening
+ * brackets, strings and primitives outside strings. Blocks of 64 bytes are
+ * classified with vector compares and counted with popcounts; the inside of
+ * strings comes from a prefix XOR of the quotes. Blocks with a backslash or
+ * a NUL go through the scalar count, which tracks escapes.
+ */
+extern jr_idx jr_scan_count(jr_idx len, char const *js)
+{
+    struct count_state state = {0, false, false, false};
+    jr_idx pos = 0;
+#ifdef JR_SCAN_X86
+    if (scan_level() != SCAN_SCALAR) pos = count_wide(&state, len, js);
+#endif
+    if (pos < len) count_scalar(&state, len - pos, js + pos);
+    return state.count;
+}
+
+static int scan_detect(void)
+{
+#ifdef JR_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SCAN_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SCAN_SSE2;
+#endif
+    return SCAN_SCALAR;
+}
+
+/* Relaxed atomics keep the check as cheap as a plain load */
+static inline int scan_level(void)
+{
+#ifdef JR_SCAN_X86
+    int level = __atomic_load_n(&scan_cached, __ATOMIC_RELAXED);
+    if (level == SCAN_UNKNOWN)
+    {
+        level = scan_detect();
+        __atomic_store_n(&scan_cached, level, __ATOMIC_RELAXED);
+    }
+    return level;
+#else
+    return scan_detect();
+#endif
+}
+
+static jr_idx string_scalar(jr_idx pos, jr_idx len, char const *js)
+{
+    for (; pos < len; pos++)
+    {
+        char c = js[pos];
+        if (c == '\"' || c == '\\' || c == '\0') break;
+    }
+    return pos;
+}
+
+static jr_idx text_scalar(jr_idx pos, jr_idx len, char const *js)
+{
+    for (; pos < len; pos++)
+    {
+        unsigned char c = (unsigned char)js[pos];
+        if (c == '\"' || c == '\\' || c < 0x20 || c >= 0x80) break;
+    }
+    return pos;
+}
+
+static jr_idx space_scalar(jr_idx pos, jr_idx len, char const *js)
+{
+    while (pos < len && scan_is_space(js[pos]))
+        pos++;
+    return pos;
+}
+
+/* Returns false at a NUL, where the parser stops too */
+static bool count_scalar(struct count_state *s, jr_idx len, char const *js)
+{
+    for (jr_idx pos = 0; pos < len; ++pos)
+    {
+        char c = js[pos];
+        if (c == '\0') return false;
+        if (s->string)
+        {
+            if (s->escape) s->escape = false;
+            else if (c == '\\') s->escape = true;
+            else if (c == '\"') s->string = false;
+            continue;
+        }
+        bool other = false;
+        switch (c)
+        {
+        case '\"':
+            s->string = true;
+            s->count++;
+            break;
+        case '{':
+        case '[':
+            s->count++;
+            break;
+        case '}':
+        case ']':
+        case ',':
+        case ':':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            break;
+        default:
+            if (!s->primitive) s->count++;
+            other = true;
+        }
+        s->primitive = other;
+    }
+    return true;
+}
+
+#ifdef JR_SCAN_X86
+static jr_idx count_wide(struct count_state *s, jr_idx len, char const *js)
+{
+    int level = scan_level();
+    jr_idx pos = 0;
+    for (; pos + 64 <= len; pos += 64)
+    {
+        struct count_block b;
+        if (level == SCAN_AVX2) block_avx2(js + pos, &b);
+        else block_sse2(js + pos, &b);
+        if (!b.slow && !s->escape) count_masks(s, &b);
+        else if (!count_scalar(s, 64, js + pos)) return len;
+    }
+    return pos;
+}
+
+static void count_masks(struct count_state *s, struct count_block const *b)
+{
+    /* Set from each opening quote up to its closing one, excluded */
+    uint64_t inside = b->quote;
+    for (int shift = 1; shift < 64; shift *= 2)
+        inside ^= inside << shift;
+    if (s->string) inside = ~inside;
+
+    uint64_t other = b->other & ~inside;
+    uint64_t starts = other & ~(other << 1 | (uint64_t)s->primitive);
+    s->count += __builtin_popcountll(b->quote & inside);
+    s->count += __builtin_popcountll(b->open & ~inside);
+    s->count += __builtin_popcountll(starts);
+    s->string = inside >> 63;
+    s->primitive = other >> 63;
+}
+
+__attribute__((target("sse2"))) static uint64_t eq_sse2(__m128i x, char c)
+{
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c)));
+}
+
+__attribute__((target("sse2"))) static void
+block_sse2(char const *js, struct count_block *b)
+{
+    *b = (struct count_block){0, 0, 0, 0};
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i x = _mm_loadu_si128((__m128i const *)(js + 16 * i));
+        uint64_t quote = eq_sse2(x, '\"');
+        uint64_t open = eq_sse2(x, '{') | eq_sse2(x, '[');
+        uint64_t close = eq_sse2(x, '}') | eq_sse2(x, ']');
+        uint64_t punct = eq_sse2(x, ',') | eq_sse2(x, ':');
+        uint64_t space = eq_sse2(x, ' ') | eq_sse2(x, '\t') |
+                         eq_sse2(x, '\n') | eq_sse2(x, '\r');
+        uint64_t slow = eq_sse2(x, '\\') | eq_sse2(x, '\0');
+        uint64_t other = ~(quote | open | close | punct | space) & 0xFFFF;
+        b->quote |= quote << (16 * i);
+        b->open |= open << (16 * i);
+        b->other |= other << (16 * i);
+        b->slow |= slow << (16 * i);
+    }
+}
+
+__attribute__((target("avx2"))) static uint64_t eq_avx2(__m256i x, char c)
+{
+    __m256i m = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c));
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2"))) static void
+block_avx2(char const *js, struct count_block *b)
+{
+    *b = (struct count_block){0, 0, 0, 0};
+    for (int i = 0; i < 2; ++i)
+    {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(js + 32 * i));
+        uint64_t quote = eq_avx2(x, '\"');
+        uint64_t open = eq_avx2(x, '{') | eq_avx2(x, '[');
+        uint64_t close = eq_avx2(x, '}') | eq_avx2(x, ']');
+        uint64_t punct = eq_avx2(x, ',') | eq_avx2(x, ':');
+        uint64_t space = eq_avx2(x, ' ') | eq_avx2(x, '\t') |
+                         eq_avx2(x, '\n') | eq_avx2(x, '\r');
+        uint64_t slow = eq_avx2(x, '\\') | eq_avx2(x, '\0');
+        uint64_t other = ~(quote | open | close | punct | space) & 0xFFFFFFFF;
+        b->quote |= quote << (32 * i);
+        b->open |= open << (32 * i);
+        b->other |= other << (32 * i);
+        b->slow |= slow << (32 * i);
+    }
+}
+
+__attribute__((target("sse2"))) static jr_idx
+string_sse2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m128i const quote = _mm_set1_epi8('\"');
+    __m128i const bslash = _mm_set1_epi8('\\');
+    __m128i const zero = _mm_setzero_si128();
+
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i x = _mm_loadu_si128((__m128i const *)(js + pos));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote),
+                                 _mm_cmpeq_epi8(x, bslash));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, zero));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return string_scalar(pos, len, js);
+}
+
+__attribute__((target("avx2"))) static jr_idx
+string_avx2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m256i const quote = _mm256_set1_epi8('\"');
+    __m256i const bslash = _mm256_set1_epi8('\\');
+    __m256i const zero = _mm256_setzero_si256();
+
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(js + pos));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(x, quote),
+                                    _mm256_cmpeq_epi8(x, bslash));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, zero));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return string_sse2(pos, len, js);
+}
+
+/* Signed compares put the bytes from 0x80 below 0x20 as well */
+__attribute__((target("sse2"))) static jr_idx
+text_sse2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m128i const quote = _mm_set1_epi8('\"');
+    __m128i const bslash = _mm_set1_epi8('\\');
+    __m128i const space = _mm_set1_epi8(0x20);
+
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i x = _mm_loadu_si128((__m128i const *)(js + pos));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote),
+                                 _mm_cmpeq_epi8(x, bslash));
+        m = _mm_or_si128(m, _mm_cmplt_epi8(x, space));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return text_scalar(pos, len, js);
+}
+
+__attribute__((target("avx2"))) static jr_idx
+text_avx2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m256i const quote = _mm256_set1_epi8('\"');
+    __m256i const bslash = _mm256_set1_epi8('\\');
+    __m256i const space = _mm256_set1_epi8(0x20);
+
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(js + pos));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(x, quote),
+                                    _mm256_cmpeq_epi8(x, bslash));
+        m = _mm256_or_si256(m, _mm256_cmpgt_epi8(space, x));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return text_sse2(pos, len, js);
+}
+
+__attribute__((target("sse2"))) static jr_idx
+space_sse2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m128i const sp = _mm_set1_epi8(' ');
+    __m128i const tab = _mm_set1_epi8('\t');
+    __m128i const lf = _mm_set1_epi8('\n');
+    __m128i const cr = _mm_set1_epi8('\r');
+
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i x = _mm_loadu_si128((__m128i const *)(js + pos));
+        __m128i m =
+            _mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, lf));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, cr));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return space_scalar(pos, len, js);
+}
+
+__attribute__((target("avx2"))) static jr_idx
+space_avx2(jr_idx pos, jr_idx len, char const *js)
+{
+    __m256i const sp = _mm256_set1_epi8(' ');
+    __m256i const tab = _mm256_set1_epi8('\t');
+    __m256i const lf = _mm256_set1_epi8('\n');
+    __m256i const cr = _mm256_set1_epi8('\r');
+
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(js + pos));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(x, sp),
+                                    _mm256_cmpeq_epi8(x, tab));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, lf));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, cr));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(m);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return space_sse2(pos, len, js);
+}
+#endif
+/* meld-cut-here */
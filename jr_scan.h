@@ -0,0 +1,11 @@
+#ifndef JR_SCAN_H
+#define JR_SCAN_H
+
+#include "jr_idx.h"
+
+jr_idx jr_scan_string(jr_idx pos, jr_idx len, char const *js);
+jr_idx jr_scan_text(jr_idx pos, jr_idx len, char const *js);
+jr_idx jr_scan_space(jr_idx pos, jr_idx len, char const *js);
+jr_idx jr_scan_count(jr_idx len, char const *js);
+
+#endif
@@ -0,0 +1,169 @@
+#include "jr_schema.h"
+#include "jr_number.h"
+#include "jr_scan.h"
+
+/* meld-cut-here */
+#include <limits.h>
+#include <string.h>
+
+static void schema_expect(struct jr_schema *, char c);
+static jr_idx schema_number(struct jr_schema *);
+static jr_idx schema_string(struct jr_schema *);
+
+/*
+ * Every step below does nothing once one has failed, so that a generated
+ * parser runs straight through and only checks the outcome at the end.
+ */
+void jr_schema_init(struct jr_schema *s, jr_idx length, char const *json)
+{
+    s->length = length;
+    s->json = json;
+    s->pos = 0;
+    s->count = 0;
+    s->error = JR_OK;
+}
+
+void jr_schema_key(struct jr_schema *s, char const *key, jr_idx size)
+{
+    schema_expect(s, s->count++ ? ',' : '{');
+    schema_expect(s, '\"');
+    if (s->error) return;
+
+    if (size >= s->length - s->pos || s->json[s->pos + size] != '\"' ||
+        memcmp(s->json + s->pos, key, (size_t)size))
+        s->error = JR_INVAL;
+    else s->pos += size + 1;
+    schema_expect(s, ':');
+}
+
+void jr_schema_bool(struct jr_schema *s, bool *val)
+{
+    if (s->error) return;
+    s->pos = jr_scan_space(s->pos, s->length, s->json);
+
+    char const *str = s->json + s->pos;
+    jr_idx left = s->length - s->pos;
+    if (left >= 4 && !memcmp(str, "true", 4))
+    {
+        *val = true;
+        s->pos += 4;
+    }
+    else if (left >= 5 && !memcmp(str, "false", 5))
+    {
+        *val = false;
+        s->pos += 5;
+    }
+    else s->error = JR_INVAL;
+}
+
+void jr_schema_int(struct jr_schema *s, int *val)
+{
+    long tmp = 0;
+    jr_schema_long(s, &tmp);
+    if (!s->error && (tmp < INT_MIN || tmp > INT_MAX)) s->error = JR_OUTRANGE;
+    if (!s->error) *val = (int)tmp;
+}
+
+void jr_schema_long(struct jr_schema *s, long *val)
+{
+    jr_idx size = schema_number(s);
+    long tmp = 0;
+    if (!s->error) s->error = jr_number_long(size, s->json + s->pos, &tmp);
+    if (s->error) return;
+    *val = tmp;
+    s->pos += size;
+}
+
+void jr_schema_ulong(struct jr_schema *s, unsigned long *val)
+{
+    jr_idx size = schema_number(s);
+    unsigned long tmp = 0;
+    if (!s->error) s->error = jr_number_ulong(size, s->json + s->pos, &tmp);
+    if (s->error) return;
+    *val = tmp;
+    s->pos += size;
+}
+
+void jr_schema_double(struct jr_schema *s, double *val)
+{
+    jr_idx size = schema_number(s);
+    double tmp = 0;
+    if (!s->error) s->error = jr_number_double(size, s->json + s->pos, &tmp);
+    if (s->error) return;
+    *val = tmp;
+    s->pos += size;
+}
+
+void jr_schema_string(struct jr_schema *s, char *dst, size_t size)
+{
+    jr_idx len = schema_string(s);
+    if (!s->error && (size_t)len >= size) s->error = JR_NOMEM;
+    if (s->error) return;
+    memcpy(dst, s->json + s->pos, (size_t)len);
+    dst[len] = '\0';
+    s->pos += len + 1;
+}
+
+void jr_schema_strview(struct jr_schema *s, struct jr_strview *val)
+{
+    jr_idx len = schema_string(s);
+    if (s->error) return;
+    val->ptr = s->json + s->pos;
+    val->len = (size_t)len;
+    s->pos += len + 1;
+}
+
+/* Whether the record closes right after the last field */
+bool jr_schema_end(struct jr_schema *s)
+{
+    if (!s->count) schema_expect(s, '{');
+    schema_expect(s, '}');
+    if (s->error) return false;
+    s->pos = jr_scan_space(s->pos, s->length, s->json);
+    return s->pos == s->length || s->json[s->pos] == '\0';
+}
+
+static void schema_expect(struct jr_schema *s, char c)
+{
+    if (s->error) return;
+    s->pos = jr_scan_space(s->pos, s->length, s->json);
+    if (s->pos < s->length && s->json[s->pos] == c) s->pos++;
+    else s->error = JR_INVAL;
+}
+
+/* Length of the number at pos, leading zeros being left to the parser */
+static jr_idx schema_number(struct jr_schema *s)
+{
+    if (s->error) return 0;
+    s->pos = jr_scan_space(s->pos, s->length, s->json);
+
+    char const *str = s->json + s->pos;
+    jr_idx size = 0;
+    jr_idx left = s->length - s->pos;
+    while (size < left && ((str[size] >= '0' && str[size] <= '9') ||
+                           str[size] == '-' || str[size] == '+' ||
+                           str[size] == '.' || str[size] == 'e' ||
+                           str[size] == 'E'))
+        size++;
+
+    jr_idx digit = size > 0 && str[0] == '-';
+    if (size == 0 || (size > digit + 1 && str[digit] == '0' &&
+                      str[digit + 1] >= '0' && str[digit + 1] <= '9'))
+        s->error = JR_INVAL;
+    return size;
+}
+
+/* Length of the plain string after the quote, which pos is then moved past */
+static jr_idx schema_string(struct jr_schema *s)
+{
+    schema_expect(s, '\"');
+    if (s->error) return 0;
+
+    jr_idx end = jr_scan_string(s->pos, s->length, s->json);
+    if (end >= s->length || s->json[end] != '\"')
+    {
+        s->error = JR_INVAL;
+        return 0;
+    }
+    return end - s->pos;
+}
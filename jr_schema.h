@@ -0,0 +1,79 @@
+#ifndef JR_SCHEMA_H
+#define JR_SCHEMA_H
+
+#include "jr.h"
+
+/* meld-cut-here */
+/* Reads a record of known shape straight from the buffer, without nodes */
+struct jr_schema
+{
+    jr_idx length;
+    char const *json;
+    jr_idx pos;
+    int count;
+    int error;
+};
+
+void jr_schema_init(struct jr_schema *, jr_idx length, char const *json);
+void jr_schema_key(struct jr_schema *, char const *key, jr_idx size);
+void jr_schema_bool(struct jr_schema *, bool *);
+void jr_schema_int(struct jr_schema *, int *);
+void jr_schema_long(struct jr_schema *, long *);
+void jr_schema_ulong(struct jr_schema *, unsigned long *);
+void jr_schema_double(struct jr_schema *, double *);
+void jr_schema_string(struct jr_schema *, char *dst, size_t size);
+void jr_schema_strview(struct jr_schema *, struct jr_strview *);
+bool jr_schema_end(struct jr_schema *);
+
+#define JR_SCHEMA_READ_BOOL(S, M) jr_schema_bool(S, &(M))
+#define JR_SCHEMA_READ_INT(S, M) jr_schema_int(S, &(M))
+#define JR_SCHEMA_READ_LONG(S, M) jr_schema_long(S, &(M))
+#define JR_SCHEMA_READ_ULONG(S, M) jr_schema_ulong(S, &(M))
+#define JR_SCHEMA_READ_DOUBLE(S, M) jr_schema_double(S, &(M))
+#define JR_SCHEMA_READ_STRING(S, M) jr_schema_string(S, M, sizeof(M))
+#define JR_SCHEMA_READ_STRVIEW(S, M) jr_schema_strview(S, &(M))
+
+#define JR_SCHEMA_FIELD(S, M, T)                                               \
+    jr_schema_key(&schema, #M, sizeof(#M) - 1);                                \
+    JR_SCHEMA_READ_##T(&schema, out.M);
+
+/*
+ * Define NAME(jr, length, json, dst), a parser dedicated to the records
+ * whose members are exactly the JR_FIELD list FIELDS, in that order and
+ * without escapes in keys or strings. Their values are read from the
+ * buffer without building nodes, and jr is left untouched. Any other
+ * record is parsed into jr and bound with jr_bind, which also gives the
+ * result, or has every field missing if it does not parse. Either way the
+ * fields are read into a copy of *dst, stored back once the whole record
+ * has been read, so a record that does not parse leaves dst alone.
+ */
+#define JR_SCHEMA(NAME, S, FIELDS)                                             \
+    static struct jr_field const NAME##_fields[] = {FIELDS(JR_FIELD)};         \
+    static struct jr_bound NAME(struct jr jr[], jr_idx length, char *json,     \
+                                S *dst)                                        \
+    {                                                                          \
+        S out = *dst;                                                          \
+        struct jr_schema schema;                                               \
+        jr_schema_init(&schema, length, json);                                 \
+        FIELDS(JR_SCHEMA_FIELD)                                                \
+        if (jr_schema_end(&schema))                                            \
+        {                                                                      \
+            *dst = out;                                                        \
+            return (struct jr_bound){0, 0};                                    \
+        }                                                                      \
+        int size = (int)(sizeof(NAME##_fields) / sizeof(NAME##_fields[0]));    \
+        struct jr_bound bound = {0, 0};                                        \
+        if (jr_parse(jr, length, json))                                        \
+        {                                                                      \
+            if (size > 0 && size <= JR_BIND_MAX_FIELDS)                        \
+                bound.missing = UINT64_MAX >> (64 - size);                     \
+            return bound;                                                      \
+        }                                                                      \
+        out = *dst;                                                            \
+        bound = jr_bind(jr, size, NAME##_fields, &out);                        \
+        *dst = out;                                                            \
+        return bound;                                                          \
+    }
+/* meld-cut-here */
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef JR_STRVIEW_H
+#define JR_STRVIEW_H
+
+/* meld-cut-here */
+#include <stddef.h>
+
+struct jr_strview
+{
+    char const *ptr;
+    size_t len;
+};
+/* meld-cut-here */
+
+#endif
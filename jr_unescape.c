@@ -0,0 +1,146 @@
+#include "jr_unescape.h"
+#include "jr_error.h"
+#include "jr_scan.h"
+
+/* meld-cut-here */
+#include <string.h>
+
+/* Stands in for surrogates that are not part of a pair */
+#define UNESCAPE_REPLACEMENT 0xFFFD
+
+static int unescape_one(jr_idx size, char const *src, jr_idx *pos,
+                        char *utf8);
+static int unescape_hex4(char const *str);
+static int unescape_utf8(unsigned code, char *utf8);
+
+/*
+ * Decode the escapes of a parsed string body into at most cap bytes of dst,
+ * which may be src itself: the output is never longer than the input. On
+ * JR_NOMEM, dst holds the first *len bytes that fit.
+ */
+extern int jr_unescape_span(jr_idx size, char const *src, char *dst,
+                            jr_idx cap, jr_idx *len)
+{
+    jr_idx pos = 0;
+    *len = 0;
+
+    while (pos < size)
+    {
+        /* Plain runs need no decoding: find the next backslash wide */
+        jr_idx end = jr_scan_string(pos, size, src);
+        jr_idx run = end - pos < cap - *len ? end - pos : cap - *len;
+        memmove(dst + *len, src + pos, (size_t)run);
+        *len += run;
+        if (pos + run < end) return JR_NOMEM;
+        pos = end;
+        if (pos == size) break;
+
+        char utf8[4];
+        int n = unescape_one(size, src, &pos, utf8);
+        if (n < 0) return JR_INVAL;
+        if (*len + n > cap) return JR_NOMEM;
+        memcpy(dst + *len, utf8, (size_t)n);
+        *len += n;
+    }
+    return JR_OK;
+}
+
+/* Decode the escape at *pos, moving past it; the byte count, or -1 */
+static int unescape_one(jr_idx size, char const *src, jr_idx *pos,
+                        char *utf8)
+{
+    jr_idx i = *pos;
+    if (src[i] != '\\' || i + 1 >= size) return -1;
+    *pos = i + 2;
+
+    switch (src[i + 1])
+    {
+    case '\"':
+    case '\\':
+    case '/':
+        utf8[0] = src[i + 1];
+        return 1;
+    case 'b':
+        utf8[0] = '\b';
+        return 1;
+    case 'f':
+        utf8[0] = '\f';
+        return 1;
+    case 'n':
+        utf8[0] = '\n';
+        return 1;
+    case 'r':
+        utf8[0] = '\r';
+        return 1;
+    case 't':
+        utf8[0] = '\t';
+        return 1;
+    case 'u':
+        break;
+    default:
+        return -1;
+    }
+
+    if (i + 6 > size) return -1;
+    int code = unescape_hex4(src + i + 2);
+    if (code < 0) return -1;
+    *pos = i + 6;
+
+    if (code >= 0xD800 && code <= 0xDBFF && i + 12 <= size &&
+        src[i + 6] == '\\' && src[i + 7] == 'u')
+    {
+        int low = unescape_hex4(src + i + 8);
+        if (low >= 0xDC00 && low <= 0xDFFF)
+        {
+            *pos = i + 12;
+            unsigned pair = 0x10000 + (((unsigned)code - 0xD800) << 10) +
+                            ((unsigned)low - 0xDC00);
+            return unescape_utf8(pair, utf8);
+        }
+    }
+    if (code >= 0xD800 && code <= 0xDFFF) code = UNESCAPE_REPLACEMENT;
+    return unescape_utf8((unsigned)code, utf8);
+}
+
+static int unescape_hex4(char const *str)
+{
+    int code = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        char c = str[i];
+        code <<= 4;
+        if (c >= '0' && c <= '9') code |= c - '0';
+        else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+        else return -1;
+    }
+    return code;
+}
+
+static int unescape_utf8(unsigned code, char *utf8)
+{
+    if (code < 0x80)
+    {
+        utf8[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        utf8[0] = (char)(0xC0 | (code >> 6));
+        utf8[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        utf8[0] = (char)(0xE0 | (code >> 12));
+        utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    utf8[0] = (char)(0xF0 | (code >> 18));
+    utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    utf8[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+/* meld-cut-here */
@@ -0,0 +1,9 @@
+#ifndef JR_UNESCAPE_H
+#define JR_UNESCAPE_H
+
+#include "jr_idx.h"
+
+int jr_unescape_span(jr_idx size, char const *src, char *dst, jr_idx cap,
+                     jr_idx *len);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef JR_VALUE_H
+#define JR_VALUE_H
+
+#include "jr_idx.h"
+
+/* meld-cut-here */
+union jr_value
+{
+    long integer;
+    double real;
+};
+
+/*
+ * Numbers decoded at parse time, kept apart from the parser and the nodes,
+ * and the count of documents parsed since JR_INIT, which dates indexes.
+ */
+struct jr_cache
+{
+    union jr_value *values;
+    jr_idx size;
+    unsigned generation;
+};
+/* meld-cut-here */
+
+#endif
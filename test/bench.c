@@ -0,0 +1,116 @@
+#include "jx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Throughput of validation, the SAX walk and a full parse over an array of
+ * records, each mode timed on the same buffer with the best of a few runs.
+ */
+enum
+{
+    ROUNDS = 5,
+    TARGET = 64 << 20,
+};
+
+static char const record[] =
+    "{\"id\":%d,\"name\":\"Homoserine_dh\",\"score\":%d.5,\"tags\":[1,2,3],"
+    "\"ok\":true,\"seq\":\"CCTATCATTTCGACGCTCAAGGAGTCGCTGACAGGTGACC\"}";
+
+struct sum
+{
+    bool score;
+    double total;
+};
+
+static int sum_scores(struct jr_sax const *sax, void *arg)
+{
+    struct sum *s = arg;
+    if (sax->event == JR_SAX_KEY)
+    {
+        s->score = sax->end - sax->start == 5 &&
+                   !memcmp(sax->json + sax->start, "score", 5);
+        return JR_OK;
+    }
+    if (sax->event == JR_SAX_NUMBER && s->score)
+    {
+        double val = 0;
+        if (jr_sax_double(sax, &val)) return JR_INVAL;
+        s->total += val;
+    }
+    s->score = false;
+    return JR_OK;
+}
+
+static char *make_records(jr_idx *length)
+{
+    size_t cap = TARGET < JR_IDX_MAX ? TARGET : JR_IDX_MAX - 1;
+    char *json = malloc(cap + 1);
+    if (!json) return NULL;
+
+    size_t len = 0;
+    json[len++] = '[';
+    for (int i = 0;; ++i)
+    {
+        char buf[sizeof record + 32];
+        int n = sprintf(buf, record, i, i);
+        if (len + (size_t)n + 2 > cap) break;
+        if (i) json[len++] = ',';
+        memcpy(json + len, buf, (size_t)n);
+        len += (size_t)n;
+    }
+    json[len++] = ']';
+    json[len] = '\0';
+    *length = (jr_idx)len;
+    return json;
+}
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(char const *mode, jr_idx length, double best)
+{
+    printf("%-10s %8.1f MB/s\n", mode, length / best / 1e6);
+}
+
+int main(void)
+{
+    jr_idx length = 0;
+    char *json = make_records(&length);
+    if (!json) return 1;
+    jr_idx n = jr_count_nodes(json, length);
+    printf("%.1f MB, %ld nodes\n", length / 1e6, (long)n);
+
+    struct jr_doc doc = {0};
+    if (jr_doc_init(&doc, NULL, JR_SIZE_FOR(n))) return 1;
+
+    double best[3] = {1e9, 1e9, 1e9};
+    for (int r = 0; r < ROUNDS; ++r)
+    {
+        clock_t start = clock();
+        if (jr_validate(json, length, NULL)) return 1;
+        double t = seconds(start);
+        if (t < best[0]) best[0] = t;
+
+        struct sum s = {false, 0};
+        start = clock();
+        if (jr_parse_sax(json, length, NULL, sum_scores, &s)) return 1;
+        t = seconds(start);
+        if (t < best[1]) best[1] = t;
+
+        start = clock();
+        if (jr_doc_parse_const(&doc, length, json)) return 1;
+        t = seconds(start);
+        if (t < best[2]) best[2] = t;
+    }
+    report("validate", length, best[0]);
+    report("sax", length, best[1]);
+    report("parse", length, best[2]);
+
+    jr_doc_cleanup(&doc);
+    free(json);
+    return 0;
+}
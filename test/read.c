@@ -1,7 +1,12 @@
 #include "jx.h"
 #include "utils.h"
 #include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 JR_DECLARE(jr, 128);
 
@@ -16,6 +21,51 @@ static char another_json[] =
     "{\"id\":2,\"type\":0,\"state\":\"pend\",\"progress\":0,\"error\":\"\","
     "\"submission\":1662640473,\"exec_started\":0,\"exec_ended\":0}";
 static char empty_json[] = "true";
+static char long_string_json[] =
+    "[ \"ACGTACGTACGTACGTACGTACGTACGTACG\\\"TACGTACGTACGTACGTACGTACGTACGTAC\","
+    "\n        \"ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT\\\\\","
+    "\t\"\\u00e9\" ]";
+static char records_json[] =
+    "[{\"id\":1,\"tags\":[1,2,{\"a\":[3]}]},{\"id\":2},{\"x\":{},\"id\":3}]";
+static char index_json[] =
+    "{\"id\":2,\"type\":0,\"state\":\"pend\",\"progress\":0,\"error\":\"\","
+    "\"submission\":1662640473,\"exec_started\":0,\"exec_ended\":0,"
+    "\"id\":3}";
+static char feed_json[] =
+    "{\"name\": \"Homo\\\"ser\\u00e9ine\", \"id\": 12345, \"data\": "
+    "[true, null, -1.5e3, \"CCTATCATTTCGACGCTCAAGGAGTCGCTGACAGGTG\"]}";
+static char lines_json[] =
+    "{\"id\":1,\"name\":\"Homoserine_dh\"}\n"
+    "\n"
+    "  {\"id\":2,\"name\":\"AA_kinase\"}\r\n"
+    "{\"id\":3,\"name\":\"}\n"
+    "{\"id\":4,\"name\":\"23ISL\"}\n"
+    "123\n"
+    "  true \n"
+    "\"s\"\n"
+    "tru\n"
+    "-1.5";
+static char const const_json[] =
+    "{\"name\":\"Homoserine_dh\",\"id\":-12,\"score\":0.5,\"ok\":true}";
+static char numbers_json[] =
+    "[-9223372036854775808, 9223372036854775807, 9223372036854775808,"
+    " 18446744073709551615, 18446744073709551616, -1, 1.5, 0.1, 1e22,"
+    " 1e23, 5e-324, 1.7976931348623157e308, 1e309, -0.0,"
+    " 3.14159265358979323846264338327950288, 0.000123456789012345678,"
+    " 0e99999, -0.000e+99999999]";
+static char grammar_json[] =
+    "[true, false, null, 0, -0, 1.5e+3, -2E-2, 100000000000000000000001]";
+static char const *bad_primitives[] = {
+    "[tru]",  "[nul]", "[falsey]", "[1e+x]", "[01]", "[-]",
+    "[1.]",   "[1e]",  "[--1]",    "[1.5.]", "[+1]", "[0x10]",
+    "[1,2-]", NULL,
+};
+static char cache_json[] =
+    "{\"id\":-42,\"score\":0.25,\"big\":18446744073709551615,\"n\":7}";
+static char text_json[] =
+    "{\"seq\":\"ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT"
+    "ACGT\\n\\\"Homo\\\"\\t\\/\\\\ACGT\",\"u\":\"\\u00e9\\u20AC\\ud83d\\ude00"
+    "\\ud800x\",\"k\\u00e9y\":1,\"plain\":\"Homoserine\"}";
 static char wrong_key[] =
     "[{\"id\":1,\"name\":\"Homoserine_dh-consensus\",\"data\":"
     "\"CCTATCATTTCGACGCTCAAGGAGTCGCTGACAGGTGACCGTATTACTCGAATCGAAGGGATATTAAACGGC"
@@ -56,6 +106,30 @@ static void test_single_true(void);
 static void test_another(void);
 static void test_empty(void);
 static void test_wrong_key(void);
+static void test_long_string(void);
+static void test_skip(void);
+static void test_index(void);
+static void test_feed(void);
+static void test_lines(void);
+static void test_lines_parallel(void);
+static void test_const(void);
+static void test_numbers(void);
+static void test_grammar(void);
+static void test_cache(void);
+static void test_text(void);
+static void test_strview(void);
+static void test_bookmark(void);
+static void test_iter(void);
+static void test_capacity(void);
+static void test_doc(void);
+static void test_count(void);
+static void test_depth(void);
+static void test_validate(void);
+static void test_project(void);
+static void test_path(void);
+static void test_bind(void);
+static void test_schema(void);
+static void test_sax(void);
 
 int main(void)
 {
@@ -70,6 +144,30 @@ int main(void)
     test_another();
     test_empty();
     test_wrong_key();
+    test_long_string();
+    test_skip();
+    test_index();
+    test_feed();
+    test_lines();
+    test_lines_parallel();
+    test_const();
+    test_numbers();
+    test_grammar();
+    test_cache();
+    test_text();
+    test_strview();
+    test_bookmark();
+    test_iter();
+    test_capacity();
+    test_doc();
+    test_count();
+    test_depth();
+    test_validate();
+    test_project();
+    test_path();
+    test_bind();
+    test_schema();
+    test_sax();
     return 0;
 }
 
@@ -91,6 +189,7 @@ static void test_person(void)
     ASSERT(jr_type(jr_next(jr)) == JR_SENTINEL);
     ASSERT(jr_nchild(jr) == 0);
 
+#ifdef JR_BACK
     ASSERT(jr_type(jr_back(jr)) == JR_NUMBER);
     ASSERT(jr_type(jr_back(jr)) == JR_STRING);
     ASSERT(jr_type(jr_back(jr)) == JR_STRING);
@@ -100,20 +199,37 @@ static void test_person(void)
 
     ASSERT(jr_type(jr_up(jr)) == JR_SENTINEL);
     ASSERT(jr_type(jr_back(jr)) == JR_OBJECT);
+#else
+    jr_reset(jr);
+    ASSERT(jr_type(jr_up(jr)) == JR_SENTINEL);
+    jr_reset(jr);
+#endif
     ASSERT(jr_type(jr_down(jr)) == JR_STRING);
     ASSERT(jr_type(jr_down(jr)) == JR_STRING);
     ASSERT(jr_type(jr_down(jr)) == JR_SENTINEL);
     ASSERT(jr_type(jr_down(jr)) == JR_SENTINEL);
+#ifdef JR_BACK
     ASSERT(jr_type(jr_back(jr)) == JR_STRING);
     ASSERT(jr_type(jr_back(jr)) == JR_STRING);
     ASSERT(jr_type(jr_back(jr)) == JR_OBJECT);
 
     ASSERT(jr_type(jr_right(jr)) == JR_SENTINEL);
     ASSERT(jr_type(jr_back(jr)) == JR_OBJECT);
+#else
+    jr_reset(jr);
+    ASSERT(jr_type(jr_right(jr)) == JR_SENTINEL);
+    jr_reset(jr);
+#endif
     ASSERT(jr_type(jr_down(jr)) == JR_STRING);
     ASSERT(jr_type(jr_right(jr)) == JR_STRING);
+    jr_idx age = jr_bookmark(jr);
     ASSERT(jr_type(jr_right(jr)) == JR_SENTINEL);
+#ifdef JR_BACK
     ASSERT(jr_type(jr_back(jr)) == JR_STRING);
+    ASSERT(jr_bookmark(jr) == age);
+#else
+    ASSERT(jr_type(jr_restore(jr, age)) == JR_STRING);
+#endif
     ASSERT(jr_type(jr_up(jr)) == JR_OBJECT);
     ASSERT(jr_error() == JR_OK);
     ASSERT(jr_type(jr_object_at(jr, "notfound")) == JR_OBJECT);
@@ -159,9 +275,13 @@ static void test_array(void)
     ASSERT(jr_type(jr_next(jr)) == JR_NUMBER);
     ASSERT(jr_type(jr_next(jr)) == JR_OBJECT);
     ASSERT(jr_nchild(jr) == 2);
+#ifdef JR_BACK
     ASSERT(jr_type(jr_back(jr)) == JR_NUMBER);
     ASSERT(jr_type(jr_back(jr)) == JR_NUMBER);
     ASSERT(jr_type(jr_back(jr)) == JR_ARRAY);
+#else
+    jr_reset(jr);
+#endif
 
     ASSERT(jr_type(jr_array_at(jr, 0)) == JR_NUMBER);
     ASSERT(jr_error() == JR_OK);
@@ -281,3 +401,1178 @@ static void test_wrong_key(void)
     jr_long_of(jr, "scan_id");
     ASSERT(jr_error() == JR_NOTFOUND);
 }
+
+static void test_long_string(void)
+{
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(long_string_json), long_string_json) == JR_OK);
+    ASSERT(jr_type(jr) == JR_ARRAY);
+    ASSERT(jr_nchild(jr) == 3);
+    ASSERT(!strcmp(jr_as_string(jr_array_at(jr, 0)),
+                   "ACGTACGTACGTACGTACGTACGTACGTACG\\\"TACGTACGTACGTACGTACGTAC"
+                   "GTACGTAC"));
+    jr_up(jr);
+    ASSERT(!strcmp(jr_as_string(jr_array_at(jr, 1)),
+                   "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT\\\\"));
+    jr_up(jr);
+    ASSERT(!strcmp(jr_as_string(jr_array_at(jr, 2)), "\\u00e9"));
+    ASSERT(jr_error() == JR_OK);
+}
+
+static void test_skip(void)
+{
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(records_json), records_json) == JR_OK);
+    ASSERT(jr_type(jr_down(jr)) == JR_OBJECT);
+    ASSERT(jr_type(jr_down(jr)) == JR_STRING);
+    ASSERT(jr_type(jr_right(jr)) == JR_STRING);
+    ASSERT(jr_type(jr_right(jr)) == JR_SENTINEL);
+#ifdef JR_BACK
+    ASSERT(jr_type(jr_back(jr)) == JR_STRING);
+    ASSERT(jr_type(jr_back(jr)) == JR_STRING);
+    ASSERT(jr_type(jr_up(jr)) == JR_OBJECT);
+    ASSERT(jr_type(jr_right(jr)) == JR_OBJECT);
+    ASSERT(jr_long_of(jr, "id") == 2);
+    ASSERT(jr_type(jr_back(jr)) == JR_OBJECT);
+    ASSERT(jr_long_of(jr, "id") == 1);
+#else
+    jr_reset(jr);
+    jr_down(jr);
+    jr_idx first = jr_bookmark(jr);
+    ASSERT(jr_type(jr_right(jr)) == JR_OBJECT);
+    ASSERT(jr_long_of(jr, "id") == 2);
+    ASSERT(jr_type(jr_restore(jr, first)) == JR_OBJECT);
+    ASSERT(jr_long_of(jr, "id") == 1);
+#endif
+    ASSERT(jr_type(jr_right(jr)) == JR_OBJECT);
+    ASSERT(jr_type(jr_right(jr)) == JR_OBJECT);
+    ASSERT(jr_long_of(jr, "id") == 3);
+    ASSERT(jr_type(jr_right(jr)) == JR_SENTINEL);
+    jr_reset(jr);
+    ASSERT(jr_long_of(jr_array_at(jr, 2), "id") == 3);
+    ASSERT(jr_error() == JR_OK);
+}
+
+static void test_index(void)
+{
+    jr_idx slot[32] = {0};
+    struct jr_index index = {0};
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(index_json), index_json) == JR_OK);
+
+    jr_index_init(&index, 20, slot);
+    ASSERT(jr_type(jr_index_at(jr, &index, "state")) == JR_STRING);
+    ASSERT(jr_type(jr_up(jr)) == JR_STRING);
+    ASSERT(jr_type(jr_up(jr)) == JR_OBJECT);
+    ASSERT(jr_type(jr_index_at(jr, &index, "nope")) == JR_OBJECT);
+    ASSERT(jr_error() == JR_NOTFOUND);
+    jr_reset(jr);
+    ASSERT(jr_type(jr_index_at(jr, &index, "id")) == JR_NUMBER);
+    ASSERT(jr_as_long(jr) == 2);
+    jr_up(jr);
+    jr_up(jr);
+    ASSERT(jr_as_long(jr_index_at(jr, &index, "exec_ended")) == 0);
+    ASSERT(jr_error() == JR_OK);
+
+    /* Too small for nine keys: same answers through the linear scan */
+    jr_up(jr);
+    jr_up(jr);
+    jr_index_init(&index, 8, slot);
+    ASSERT(jr_as_long(jr_index_at(jr, &index, "submission")) == 1662640473);
+    jr_up(jr);
+    jr_up(jr);
+    ASSERT(jr_long_of(jr, "id") == 2);
+    ASSERT(jr_error() == JR_OK);
+
+    /* A new document in the same jr gets a new table */
+    char first[] = "{\"a\":1,\"b\":2,\"c\":3}";
+    char second[] = "{\"c\":5,\"b\":7,\"a\":9}";
+    jr_index_init(&index, 8, slot);
+    ASSERT(!jr_parse(jr, strlen(first), first));
+    ASSERT(jr_as_long(jr_index_at(jr, &index, "b")) == 2);
+    ASSERT(!jr_parse(jr, strlen(second), second));
+    ASSERT(jr_as_long(jr_index_at(jr, &index, "a")) == 9);
+    jr_up(jr);
+    jr_up(jr);
+    ASSERT(jr_as_long(jr_index_at(jr, &index, "c")) == 5);
+    ASSERT(jr_error() == JR_OK);
+}
+
+static void test_feed(void)
+{
+    char json[sizeof feed_json] = {0};
+    int size = (int)strlen(feed_json);
+
+    for (int chunk = 1; chunk <= size; chunk += 4)
+    {
+        JR_INIT(jr);
+        memcpy(json, feed_json, sizeof feed_json);
+        for (int i = chunk; i < size; i += chunk)
+            ASSERT(jr_feed(jr, i, json) == JR_OK);
+        ASSERT(jr_feed(jr, size, json) == JR_OK);
+        ASSERT(jr_finish(jr) == JR_OK);
+
+        ASSERT(jr_nchild(jr) == 3);
+        ASSERT(!strcmp(jr_string_of(jr, "name"), "Homo\\\"ser\\u00e9ine"));
+        ASSERT(jr_long_of(jr, "id") == 12345);
+        ASSERT(jr_type(jr_object_at(jr, "data")) == JR_ARRAY);
+        ASSERT(jr_nchild(jr) == 4);
+        ASSERT(jr_as_double(jr_array_at(jr, 2)) == -1500.0);
+        jr_reset(jr);
+        ASSERT(!strcmp(jr_as_text(jr_object_at(jr, "name")),
+                       "Homo\"ser\xc3\xa9ine"));
+        ASSERT(jr_error() == JR_OK);
+    }
+
+    JR_INIT(jr);
+    memcpy(json, feed_json, sizeof feed_json);
+    ASSERT(jr_feed(jr, 22, json) == JR_OK);
+    ASSERT(jr_finish(jr) == JR_INVAL);
+
+    /* Chunks that fill the array exactly leave the sentinel its own slot */
+    struct
+    {
+        struct jr jr[JR_SIZE_FOR(4)];
+        unsigned char guard[sizeof(struct jr)];
+    } box;
+    char nested[] = "[1,[2]]";
+    memset(box.guard, 0xA5, sizeof box.guard);
+    JR_INIT(box.jr);
+    ASSERT(jr_feed(box.jr, 4, nested) == JR_OK);
+    ASSERT(jr_feed(box.jr, 7, nested) == JR_OK);
+    ASSERT(jr_finish(box.jr) == JR_OK);
+    ASSERT(jr_type(jr_right(jr_down(box.jr))) == JR_ARRAY);
+    ASSERT(jr_type(jr_right(box.jr)) == JR_SENTINEL);
+    for (size_t i = 0; i < sizeof box.guard; ++i)
+        ASSERT(box.guard[i] == 0xA5);
+    __jr_init(box.jr, JR_SIZE_FOR(3));
+    ASSERT(jr_feed(box.jr, 4, nested) == JR_OK);
+    ASSERT(jr_feed(box.jr, 7, nested) == JR_NOMEM);
+}
+
+static void test_lines(void)
+{
+    struct jr_lines lines = {0};
+    JR_INIT(jr);
+    jr_lines_init(&lines, strlen(lines_json), lines_json);
+
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_long_of(jr, "id") == 1);
+    ASSERT(!strcmp(jr_string_of(jr, "name"), "Homoserine_dh"));
+
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(lines.start == 35);
+    ASSERT(jr_long_of(jr, "id") == 2);
+    ASSERT(!strcmp(jr_string_of(jr, "name"), "AA_kinase"));
+
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_error() == JR_INVAL);
+
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_long_of(jr, "id") == 4);
+    ASSERT(!strcmp(jr_string_of(jr, "name"), "23ISL"));
+
+    /* Records can be bare scalars, the last one without a newline */
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_as_long(jr) == 123 && jr_error() == JR_OK);
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_as_bool(jr) && jr_error() == JR_OK);
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(!strcmp(jr_as_string(jr), "s") && jr_error() == JR_OK);
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_error() == JR_INVAL);
+    ASSERT(jr_lines_next(&lines, jr));
+    ASSERT(jr_as_double(jr) == -1.5 && jr_error() == JR_OK);
+
+    ASSERT(!jr_lines_next(&lines, jr));
+}
+
+enum
+{
+    NRECORDS = 2000,
+    BAD_RECORD = 1000,
+    STOP_RECORD = 500,
+};
+static char records[NRECORDS * 32];
+static int seen[NRECORDS];
+static int next_id;
+
+static int fill_records(void)
+{
+    char *p = records;
+    for (int i = 0; i < NRECORDS; ++i)
+    {
+        char const *name = i == BAD_RECORD ? "\"x" : "\"r\"";
+        p += sprintf(p, "{\"id\":%d,\"name\":%s}\n%s", i, name,
+                     i % 7 ? "" : "\n");
+    }
+    return (int)(p - records);
+}
+
+static int count_record(struct jr jr[], int error, int64_t start, void *arg)
+{
+    (void)arg;
+    if (error) return strncmp(&records[start], "{\"id\":1000,", 10);
+    long id = jr_long_of(jr, "id");
+    if (jr_error() || id < 0 || id >= NRECORDS) return JR_INVAL;
+    seen[id]++;
+    return JR_OK;
+}
+
+static int check_order(struct jr jr[], int error, int64_t start, void *arg)
+{
+    int *stop = arg;
+    int id = error ? BAD_RECORD : (int)jr_long_of(jr, "id");
+    if (id != next_id++ || records[start] != '{') return JR_INVAL;
+    if (id == *stop) return JR_OUTRANGE;
+    return JR_OK;
+}
+
+/*
+ * Every worker waits in fn until the last one to arrive stops them all, and
+ * holds on a while longer so that the stop is recorded before it returns.
+ */
+struct stop_calls
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int workers;
+    int waiting;
+    bool stopped;
+    int late; /* calls made once the stopping one had returned */
+};
+
+static int stop_early(struct jr jr[], int error, int64_t start, void *arg)
+{
+    (void)jr;
+    (void)error;
+    (void)start;
+    struct stop_calls *calls = arg;
+    int rc = JR_OK;
+    pthread_mutex_lock(&calls->lock);
+    if (calls->stopped) calls->late++;
+    else if (calls->waiting + 1 == calls->workers)
+    {
+        calls->stopped = true;
+        pthread_cond_broadcast(&calls->cond);
+        rc = JR_OUTRANGE;
+    }
+    else
+    {
+        calls->waiting++;
+        while (!calls->stopped)
+            pthread_cond_wait(&calls->cond, &calls->lock);
+        struct timespec hold = {time(NULL) + 1, 0};
+        while (pthread_cond_timedwait(&calls->cond, &calls->lock, &hold) !=
+               ETIMEDOUT)
+            ;
+    }
+    pthread_mutex_unlock(&calls->lock);
+    return rc;
+}
+
+static void test_lines_parallel(void)
+{
+    JR_DECLARE(pool, 160);
+    struct jr_lines lines = {0};
+    int stop = NRECORDS;
+
+    jr_lines_init(&lines, fill_records(), records);
+    ASSERT(jr_lines_parallel(&lines, pool, 160, 4, false, count_record,
+                             NULL) == JR_OK);
+    for (int i = 0; i < NRECORDS; ++i)
+        ASSERT(seen[i] == (i != BAD_RECORD));
+
+    jr_lines_init(&lines, fill_records(), records);
+    ASSERT(jr_lines_parallel(&lines, pool, 160, 4, true, check_order,
+                             &stop) == JR_OK);
+    ASSERT(next_id == NRECORDS);
+
+    next_id = 0;
+    stop = STOP_RECORD;
+    jr_lines_init(&lines, fill_records(), records);
+    ASSERT(jr_lines_parallel(&lines, pool, 160, 3, true, check_order,
+                             &stop) == JR_OUTRANGE);
+    ASSERT(next_id == STOP_RECORD + 1);
+
+    /* The workers are all mid-chunk when fn stops and none calls it again */
+    struct stop_calls calls = {PTHREAD_MUTEX_INITIALIZER,
+                               PTHREAD_COND_INITIALIZER, 4, 0, false, 0};
+    jr_lines_init(&lines, fill_records(), records);
+    ASSERT(jr_lines_parallel(&lines, pool, 160, 4, false, stop_early,
+                             &calls) == JR_OUTRANGE);
+    ASSERT(calls.stopped && calls.late == 0);
+}
+
+static void test_const(void)
+{
+    char copy[sizeof const_json] = {0};
+    memcpy(copy, const_json, sizeof const_json);
+    JR_INIT(jr);
+    ASSERT(jr_parse_const(jr, strlen(const_json), const_json) == JR_OK);
+
+    ASSERT(jr_long_of(jr, "id") == -12);
+    ASSERT(jr_long_of(jr, "id") == -12);
+    ASSERT(jr_double_of(jr, "score") == 0.5);
+    ASSERT(jr_bool_of(jr, "ok"));
+    struct jr_strview name = jr_as_strview(jr_object_at(jr, "name"));
+    ASSERT(name.len == 13 && !memcmp(name.ptr, "Homoserine_dh", 13));
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(!strcmp(jr_as_string(jr), ""));
+    ASSERT(jr_error() == JR_INVAL);
+    ASSERT(!memcmp(copy, const_json, sizeof const_json));
+}
+
+static void test_numbers(void)
+{
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(numbers_json), numbers_json) == JR_OK);
+
+    ASSERT(jr_as_long(jr_array_at(jr, 0)) == LONG_MIN);
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 1)) == LONG_MAX);
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 2)) == LONG_MAX);
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    ASSERT(jr_as_ulong(jr_array_at(jr, 2)) == 9223372036854775808UL);
+    ASSERT(jr_as_ulong(jr_array_at(jr_up(jr), 3)) == ULONG_MAX);
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_as_ulong(jr_array_at(jr_up(jr), 4)) == ULONG_MAX);
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    jr_as_ulong(jr_array_at(jr, 5));
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    ASSERT(jr_as_long(jr_array_at(jr, 5)) == -1);
+    jr_as_long(jr_array_at(jr_up(jr), 6));
+    ASSERT(jr_error() == JR_INVAL);
+    jr_reset(jr);
+
+    ASSERT(jr_as_double(jr_array_at(jr, 6)) == 1.5);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 7)) == 0.1);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 8)) == 1e22);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 9)) == 1e23);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 10)) == 5e-324);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 11)) == DBL_MAX);
+    ASSERT(jr_error() == JR_OK);
+    jr_as_double(jr_array_at(jr_up(jr), 12));
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    double zero = jr_as_double(jr_array_at(jr, 13));
+    ASSERT(zero == 0.0 && 1 / zero < 0);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 14)) == 3.141592653589793);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 15)) ==
+           0.000123456789012345678);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 16)) == 0.0);
+    zero = jr_as_double(jr_array_at(jr_up(jr), 17));
+    ASSERT(zero == 0.0 && 1 / zero < 0);
+    ASSERT(jr_error() == JR_OK);
+}
+
+static void test_grammar(void)
+{
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(grammar_json), grammar_json) == JR_OK);
+    ASSERT(jr_nchild(jr) == 8);
+    ASSERT(jr_as_long(jr_array_at(jr, 4)) == 0);
+    ASSERT(jr_as_double(jr_array_at(jr_up(jr), 5)) == 1500);
+    ASSERT(jr_error() == JR_OK);
+    /* Whole numbers convert whatever their notation */
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 5)) == 1500);
+    ASSERT(jr_as_ulong(jr_array_at(jr_up(jr), 5)) == 1500);
+    ASSERT(jr_error() == JR_OK);
+    jr_as_long(jr_array_at(jr_up(jr), 6));
+    ASSERT(jr_error() == JR_INVAL);
+    jr_reset(jr);
+    ASSERT(jr_as_double(jr_array_at(jr, 7)) == 100000000000000000000001.0);
+    ASSERT(jr_error() == JR_OK);
+
+    char integral[] = "[-1.0, 1e2, 12.50e1, 0.0e-7, 1.25e1, 1e19, 1e20, 2e-1]";
+    ASSERT(jr_parse(jr, strlen(integral), integral) == JR_OK);
+    ASSERT(jr_as_long(jr_array_at(jr, 0)) == -1);
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 1)) == 100);
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 2)) == 125);
+    ASSERT(jr_as_long(jr_array_at(jr_up(jr), 3)) == 0);
+    ASSERT(jr_as_ulong(jr_array_at(jr_up(jr), 5)) == 10000000000000000000UL);
+    ASSERT(jr_error() == JR_OK);
+    jr_as_ulong(jr_array_at(jr_up(jr), 0));
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    jr_as_long(jr_array_at(jr, 4));
+    ASSERT(jr_error() == JR_INVAL);
+    jr_reset(jr);
+    jr_as_ulong(jr_array_at(jr, 6));
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+    jr_as_long(jr_array_at(jr, 7));
+    ASSERT(jr_error() == JR_INVAL);
+    jr_reset(jr);
+
+    for (char const **json = bad_primitives; *json; ++json)
+    {
+        JR_INIT(jr);
+        ASSERT(jr_parse_const(jr, strlen(*json), *json) == JR_INVAL);
+    }
+}
+
+static void test_cache(void)
+{
+    union jr_value values[8] = {0};
+    JR_INIT(jr);
+    jr_cache_numbers(jr, 8, values);
+    ASSERT(jr_parse(jr, strlen(cache_json), cache_json) == JR_OK);
+
+    /* Cached numbers no longer look at the text */
+    memset(strstr(cache_json, "-42"), '9', 3);
+    memset(strstr(cache_json, "0.25"), '9', 4);
+    ASSERT(jr_long_of(jr, "id") == -42);
+    ASSERT(jr_double_of(jr, "id") == -42.0);
+    ASSERT(jr_double_of(jr, "score") == 0.25);
+    ASSERT(jr_error() == JR_OK);
+    jr_ulong_of(jr, "id");
+    ASSERT(jr_error() == JR_OUTRANGE);
+    jr_reset(jr);
+
+    /* Out of range and beyond the values array: decoded on access */
+    ASSERT(jr_ulong_of(jr, "big") == ULONG_MAX);
+    ASSERT(jr_error() == JR_OK);
+    ASSERT(jr_long_of(jr, "n") == 7);
+
+    jr_cache_numbers(jr, 0, NULL);
+    memcpy(strstr(cache_json, "999"), "-42", 3);
+    ASSERT(jr_parse(jr, strlen(cache_json), cache_json) == JR_OK);
+    memcpy(strstr(cache_json, "-42"), "-43", 3);
+    ASSERT(jr_long_of(jr, "id") == -43);
+}
+
+static void test_text(void)
+{
+    static char const seq[] =
+        "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT"
+        "\n\"Homo\"\t/\\ACGT";
+    static char const u[] = "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"
+                            "\xef\xbf\xbdx";
+    /* Larger than jr_idx can count in the 16-bit build */
+    static char big[40000];
+    char copy[sizeof text_json] = {0};
+    char dst[128] = {0};
+    memcpy(copy, text_json, sizeof text_json);
+
+    JR_INIT(jr);
+    ASSERT(jr_parse_const(jr, strlen(copy), copy) == JR_OK);
+    jr_object_at(jr, "seq");
+    ASSERT(jr_text_copy(jr, dst, sizeof dst) == (int)strlen(seq));
+    ASSERT(!strcmp(dst, seq));
+    ASSERT(jr_text_copy(jr, dst, 8) == 7);
+    ASSERT(!strcmp(dst, "ACGTACG"));
+    ASSERT(jr_error() == JR_NOMEM);
+    jr_reset(jr);
+    ASSERT(jr_text_copy(jr_object_at(jr, "seq"), big, sizeof big) ==
+           (int)strlen(seq));
+    ASSERT(!strcmp(big, seq));
+    jr_reset(jr);
+    ASSERT(jr_text_copy(jr_object_at(jr, "plain"), big, sizeof big) == 10);
+    ASSERT(!strcmp(big, "Homoserine"));
+    ASSERT(jr_text_copy(jr, dst, sizeof dst) == 10);
+    ASSERT(!strcmp(dst, "Homoserine"));
+    ASSERT(!strcmp(jr_as_text(jr), ""));
+    ASSERT(jr_error() == JR_INVAL);
+    ASSERT(!memcmp(copy, text_json, sizeof text_json));
+
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(text_json), text_json) == JR_OK);
+    ASSERT(!strcmp(jr_as_text(jr_object_at(jr, "seq")), seq));
+    ASSERT(!strcmp(jr_as_text(jr), seq));
+    jr_reset(jr);
+    ASSERT(!strcmp(jr_as_text(jr_object_at(jr, "u")), u));
+    jr_reset(jr);
+    jr_long_of(jr, "k\xc3\xa9y");
+    ASSERT(jr_error() == JR_NOTFOUND);
+    jr_reset(jr);
+    /* The key after "u"'s value, once decoded, matches the decoded form */
+    jr_as_text(jr_next(jr_object_at(jr, "u")));
+    ASSERT(jr_long_of(jr_up(jr), "k\xc3\xa9y") == 1);
+    ASSERT(jr_error() == JR_OK);
+}
+
+static void test_strview(void)
+{
+    char dst[16] = {0};
+    JR_INIT(jr);
+    ASSERT(jr_parse_const(jr, strlen(const_json), const_json) == JR_OK);
+
+    struct jr_strview name = jr_strview_of(jr, "name");
+    ASSERT(name.len == 13 && !memcmp(name.ptr, "Homoserine_dh", 13));
+    ASSERT(name.ptr == strstr(const_json, "Homoserine_dh"));
+    ASSERT(jr_type(jr) == JR_OBJECT);
+    jr_strcpy_of(jr, "name", dst, sizeof dst);
+    ASSERT(!strcmp(dst, "Homoserine_dh"));
+    ASSERT(jr_error() == JR_OK);
+
+    jr_strcpy_of(jr, "name", dst, 5);
+    ASSERT(!strcmp(dst, "Homo"));
+    ASSERT(jr_error() == JR_NOMEM);
+    jr_reset(jr);
+    ASSERT(jr_strview_of(jr, "id").len == 0);
+    ASSERT(jr_error() == JR_INVAL);
+    jr_reset(jr);
+    ASSERT(jr_strview_of(jr, "nope").len == 0);
+    ASSERT(jr_error() == JR_NOTFOUND);
+}
+
+static void test_bookmark(void)
+{
+    char json[sizeof records_json] = {0};
+    memcpy(json, records_json, sizeof records_json);
+    JR_INIT(jr);
+    ASSERT(jr_parse(jr, strlen(json), json) == JR_OK);
+
+    int record = jr_bookmark(jr_right(jr_down(jr)));
+    ASSERT(jr_long_of(jr, "id") == 2);
+    ASSERT(jr_bookmark(jr) == record);
+    jr_next(jr_next(jr_next(jr)));
+    ASSERT(jr_type(jr) == JR_OBJECT);
+    ASSERT(jr_long_of(jr_restore(jr, record), "id") == 2);
+    ASSERT(jr_long_of(jr_restore(jr, 0), "id") == 0);
+    ASSERT(jr_error() == JR_INVAL);
+}
+
+static void *iter_sum(void *arg)
+{
+    struct jr_iter it = {0};
+    jr_iter_init(&it, arg);
+    long sum = 0;
+    for (int rep = 0; rep < 1000; ++rep)
+    {
+        struct jr_iter rec = it;
+        jr_iter_down(&rec);
+        for (; jr_iter_type(&rec) == JR_OBJECT; jr_iter_right(&rec))
+        {
+            struct jr_iter id = rec;
+            sum += jr_iter_long(jr_iter_object_at(&id, "id"));
+        }
+        if (jr_iter_error(&rec)) return NULL;
+    }
+    return (void *)sum;
+}
+
+static void test_iter(void)
+{
+    char json[sizeof records_json] = {0};
+    memcpy(json, records_json, sizeof records_json);
+    JR_DECLARE(doc, 64);
+    JR_INIT(doc);
+    ASSERT(jr_parse(doc, strlen(json), json) == JR_OK);
+
+    struct jr_iter it = {0};
+    jr_iter_init(&it, doc);
+    ASSERT(jr_iter_type(&it) == JR_ARRAY && jr_iter_nchild(&it) == 3);
+    ASSERT(jr_iter_error(jr_iter_array_at(&it, 4)) == JR_OUTRANGE);
+    ASSERT(jr_iter_type(&it) == JR_ARRAY);
+    ASSERT(jr_error() == JR_OK);
+    jr_iter_init(&it, doc);
+    jr_iter_object_at(jr_iter_array_at(&it, 0), "tags");
+    ASSERT(jr_iter_type(&it) == JR_ARRAY);
+    ASSERT(jr_iter_long(jr_iter_array_at(&it, 1)) == 2);
+    ASSERT(jr_iter_double(&it) == 2.0);
+    jr_iter_object_at(&it, "a");
+    ASSERT(jr_iter_error(&it) == JR_INVAL);
+    ASSERT(jr_iter_type(jr_iter_up(&it)) == JR_ARRAY);
+    ASSERT(jr_iter_type(jr_iter_up(jr_iter_up(jr_iter_up(&it)))) == JR_ARRAY);
+    ASSERT(jr_iter_type(jr_iter_up(&it)) == JR_SENTINEL);
+
+    struct jr snapshot[64];
+    memcpy(snapshot, doc, sizeof snapshot);
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i)
+        ASSERT(!pthread_create(&threads[i], NULL, iter_sum, doc));
+    for (int i = 0; i < 4; ++i)
+    {
+        void *sum = NULL;
+        ASSERT(!pthread_join(threads[i], &sum));
+        ASSERT((long)sum == 6000);
+    }
+    ASSERT(!memcmp(snapshot, doc, sizeof snapshot));
+}
+
+static void test_capacity(void)
+{
+    char json[] = "[1,[2]]";
+    /* Three header slots, four nodes and the sentinel */
+    JR_DECLARE(tight, 8);
+    JR_DECLARE(short_by_one, 7);
+
+    JR_INIT(short_by_one);
+    ASSERT(jr_parse(short_by_one, strlen(json), json) == JR_NOMEM);
+    JR_INIT(tight);
+    ASSERT(jr_parse(tight, strlen(json), json) == JR_OK);
+    ASSERT(jr_type(jr_next(jr_next(jr_next(jr_next(tight))))) == JR_SENTINEL);
+    jr_reset(tight);
+    ASSERT(jr_type(jr_right(jr_array_at(tight, 1))) == JR_SENTINEL);
+    /* Entries are sized by the node, never by one of the headers */
+    ASSERT(sizeof(struct jr) < sizeof(struct jr_node) + sizeof(void *));
+}
+
+struct budget
+{
+    size_t left;
+    int calls;
+};
+
+static void *budget_resize(void *ctx, void *ptr, size_t old_size,
+                           size_t new_size)
+{
+    struct budget *b = ctx;
+    if (new_size - old_size > b->left) return NULL;
+    b->left -= new_size - old_size;
+    b->calls++;
+    return realloc(ptr, new_size);
+}
+
+static void budget_release(void *ctx, void *ptr, size_t size)
+{
+    struct budget *b = ctx;
+    b->left += size;
+    free(ptr);
+}
+
+static void test_doc(void)
+{
+    static char json[32768];
+    char *p = json;
+    p += sprintf(p, "[");
+    for (int i = 0; i < 1000; ++i)
+        p += sprintf(p, "%s{\"n\":%d,\"s\":\"x\"}", i ? "," : "", i);
+    p += sprintf(p, "]");
+    jr_idx length = (jr_idx)(p - json);
+
+    struct jr_doc doc = {0};
+    ASSERT(jr_doc_init(&doc, NULL, 0) == JR_OK);
+    ASSERT(jr_doc_parse(&doc, length, json) == JR_OK);
+    ASSERT(jr_nchild(doc.jr) == 1000);
+    ASSERT(doc.size >= 2 + 5001 + 1);
+    long sum = 0;
+    for (jr_down(doc.jr); jr_type(doc.jr) != JR_SENTINEL; jr_right(doc.jr))
+    {
+        sum += jr_long_of(doc.jr, "n");
+        ASSERT(!memcmp(jr_strview_of(doc.jr, "s").ptr, "x\"", 2));
+    }
+    ASSERT(sum == 999 * 1000 / 2);
+    jr_doc_cleanup(&doc);
+    ASSERT(doc.jr == NULL);
+
+    /* Chunks cut strings and numbers, and the nodes run out in between */
+    struct budget budget = {SIZE_MAX, 0};
+    struct jr_alloc alloc = {budget_resize, budget_release, &budget};
+    ASSERT(jr_doc_init(&doc, &alloc, 4) == JR_OK);
+    for (jr_idx n = 7; n < length; n += 7)
+        ASSERT(jr_doc_feed(&doc, n, json) == JR_OK);
+    ASSERT(jr_doc_feed(&doc, length, json) == JR_OK);
+    ASSERT(jr_finish(doc.jr) == JR_OK);
+    ASSERT(budget.calls > 1);
+    ASSERT(jr_long_of(jr_array_at(doc.jr, 999), "n") == 999);
+    jr_doc_cleanup(&doc);
+    ASSERT(budget.left == SIZE_MAX);
+
+    /* Growth stops with JR_NOMEM once the allocator gives up */
+    budget.left = 64 * sizeof(struct jr);
+    ASSERT(jr_doc_init(&doc, &alloc, 8) == JR_OK);
+    ASSERT(jr_doc_parse_const(&doc, length, json) == JR_NOMEM);
+    ASSERT(doc.size == 64);
+    jr_doc_cleanup(&doc);
+}
+
+static char const *count_json[] = {
+    "[]",
+    "{}",
+    "[ 1, -2.5e3 ,true,false,null]",
+    "{\"a\":{\"b\":[{}, [], \"\"]},\"c\":\"}]{[,:\"}",
+    "[\"\\\"\", \"\\\\\", \"a\\\\\\\"b\", \"\\u0041\\n\"]",
+    "{\"long string that runs past one block of sixty-four bytes\": 12345,"
+    " \"k\" : [ 0.5 ,\"\\\\\\\\\", 7 ] }",
+};
+
+static jr_idx parsed_nodes(struct jr jr[])
+{
+    jr_idx n = 0;
+    for (jr_reset(jr); jr_type(jr) != JR_SENTINEL; jr_next(jr))
+        n++;
+    return n;
+}
+
+static void test_count(void)
+{
+    char json[256];
+    for (size_t i = 0; i < sizeof(count_json) / sizeof(*count_json); ++i)
+    {
+        /* Leading blanks move the tokens across block boundaries */
+        for (int pad = 0; pad < 70; ++pad)
+        {
+            int len = sprintf(json, "%*s%s", pad, "", count_json[i]);
+            jr_idx n = jr_count_nodes(json, len);
+            JR_INIT(jr);
+            ASSERT(jr_parse(jr, len, json) == JR_OK);
+            ASSERT(parsed_nodes(jr) == n);
+        }
+    }
+
+    /* Nested arrays of objects, as deep as the parser takes up to 500 */
+    int const depth = JR_MAX_DEPTH <= 500 ? JR_MAX_DEPTH - 1 : 500;
+    static char big[32768];
+    char *p = big;
+    for (int i = 0; i < depth; ++i)
+        p += sprintf(p, "%s{\"n\":%d,\"s\":\"x\\\"%d\"}", i ? ",[" : "[", i,
+                     i);
+    for (int i = 0; i < depth; ++i)
+        p += sprintf(p, "]");
+    jr_idx n = jr_count_nodes(big, (jr_idx)(p - big));
+
+    struct jr_doc doc = {0};
+    ASSERT(jr_doc_init(&doc, NULL, JR_SIZE_FOR(n)) == JR_OK);
+    ASSERT(jr_doc_parse(&doc, (jr_idx)(p - big), big) == JR_OK);
+    ASSERT(doc.size == (size_t)JR_SIZE_FOR(n));
+    ASSERT(parsed_nodes(doc.jr) == n);
+    jr_doc_cleanup(&doc);
+}
+
+static void test_depth(void)
+{
+    static char json[2 * JR_MAX_DEPTH + 2];
+    struct jr_doc doc = {0};
+    ASSERT(jr_doc_init(&doc, NULL, 0) == JR_OK);
+
+    memset(json, '[', JR_MAX_DEPTH);
+    memset(json + JR_MAX_DEPTH, ']', JR_MAX_DEPTH);
+    ASSERT(jr_doc_parse(&doc, 2 * JR_MAX_DEPTH, json) == JR_OK);
+    ASSERT(jr_nchild(doc.jr) == 1);
+    ASSERT(jr_type(jr_right(jr_down(doc.jr))) == JR_SENTINEL);
+
+    memset(json, '[', JR_MAX_DEPTH + 1);
+    memset(json + JR_MAX_DEPTH + 1, ']', JR_MAX_DEPTH + 1);
+    ASSERT(jr_doc_parse(&doc, 2 * JR_MAX_DEPTH + 2, json) == JR_OUTRANGE);
+    jr_doc_cleanup(&doc);
+
+    char const *bad[] = {"[1,{\"a\":2]}", "{\"a\":[1}", "[1]]",
+                         "{\"a\":[1]",    "[1:2]",        "{\"a\":1:2}",
+                         "{\"a\":{}:1}",  "\"a\":1"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(*bad); ++i)
+    {
+        char copy[32];
+        strcpy(copy, bad[i]);
+        JR_INIT(jr);
+        ASSERT(jr_parse(jr, strlen(copy), copy) == JR_INVAL);
+    }
+}
+
+struct validate_case
+{
+    char const *json;
+    int rc;
+    jr_idx offset;
+};
+
+static struct validate_case const validate_cases[] = {
+    {"{\"a\": [1, -2.5e3, true, false, null, \"\\u00e9\\n\"]}", JR_OK, 49},
+    {" 7 ", JR_OK, 3},
+    {"\"caf\xc3\xa9 \xf0\x9f\x98\x80\"", JR_OK, 12},
+    {"[1,]", JR_INVAL, 3},
+    {"[1 2]", JR_INVAL, 3},
+    {"{\"a\" 1}", JR_INVAL, 5},
+    {"{1: 2}", JR_INVAL, 1},
+    {"[01]", JR_INVAL, 1},
+    {"[tru]", JR_INVAL, 1},
+    {"[1] [2]", JR_INVAL, 4},
+    {"[\"a\\x\"]", JR_INVAL, 3},
+    {"[\"a\tb\"]", JR_INVAL, 3},
+    {"[\"\xc0\x80\"]", JR_INVAL, 2},
+    {"[\"\xed\xa0\x80\"]", JR_INVAL, 2},
+    {"[\"\xf4\x90\x80\x80\"]", JR_INVAL, 2},
+    {"[\"\xe2\x82\"]", JR_INVAL, 2},
+    {"[\"abc", JR_INVAL, 5},
+    {"{\"a\":[", JR_INVAL, 6},
+    {"", JR_INVAL, 0},
+};
+
+static void test_validate(void)
+{
+    size_t n = sizeof(validate_cases) / sizeof(*validate_cases);
+    for (size_t i = 0; i < n; ++i)
+    {
+        struct validate_case const *c = &validate_cases[i];
+        jr_idx offset = -1;
+        jr_idx len = (jr_idx)strlen(c->json);
+        ASSERT(jr_validate(c->json, len, &offset) == c->rc);
+        ASSERT(offset == c->offset);
+    }
+
+    /* Long runs go through the vector scan, errors past them too */
+    static char json[256];
+    memset(json, 0, sizeof(json));
+    json[0] = '"';
+    memset(json + 1, 'x', 200);
+    json[201] = '"';
+    ASSERT(jr_validate(json, 202, NULL) == JR_OK);
+    json[150] = '\x1f';
+    jr_idx offset = 0;
+    ASSERT(jr_validate(json, 202, &offset) == JR_INVAL);
+    ASSERT(offset == 150);
+
+    static char deep[2 * JR_MAX_DEPTH + 2];
+    memset(deep, '[', JR_MAX_DEPTH);
+    memset(deep + JR_MAX_DEPTH, ']', JR_MAX_DEPTH);
+    ASSERT(jr_validate(deep, 2 * JR_MAX_DEPTH, NULL) == JR_OK);
+    memset(deep, '[', JR_MAX_DEPTH + 1);
+    memset(deep + JR_MAX_DEPTH + 1, ']', JR_MAX_DEPTH + 1);
+    ASSERT(jr_validate(deep, 2 * JR_MAX_DEPTH + 2, &offset) == JR_OUTRANGE);
+    ASSERT(offset == JR_MAX_DEPTH);
+}
+
+static char project_json[] =
+    "{\"id\": 7, \"name\": \"x\", \"data\": \"ACGT{[\\\"ACGT\","
+    " \"meta\": {\"a\": 1, \"b\": {\"c\": [1, 2]}, \"z\": \"q\"},"
+    " \"items\": [{\"k\": 1, \"v\": 2}, {\"v\": 3, \"k\": 4}, 5],"
+    " \"tail\": [1, [2, {\"k\": 3}]]}";
+
+static void test_project(void)
+{
+    struct jr_select select[8];
+    struct jr_project project = {0};
+    jr_project_init(&project, false, 8, select);
+    ASSERT(jr_project_add(&project, "id") == JR_OK);
+    ASSERT(jr_project_add(&project, "meta.b") == JR_OK);
+    ASSERT(jr_project_add(&project, "items.k") == JR_OK);
+    ASSERT(project.count == 5);
+
+    JR_INIT(jr);
+    ASSERT(jr_parse_project(jr, &project, strlen(project_json),
+                            project_json) == JR_OK);
+    /* Root, id, meta, b, c with [1, 2], items and its three elements */
+    ASSERT(parsed_nodes(jr) == 1 + 2 + 2 + 2 + 4 + 2 + 3 + 3 + 1);
+    jr_reset(jr);
+    ASSERT(jr_nchild(jr) == 3);
+    ASSERT(jr_long_of(jr, "id") == 7);
+    ASSERT(jr_type(jr_object_at(jr, "name")) == JR_OBJECT);
+    ASSERT(jr_error() == JR_NOTFOUND);
+
+    jr_reset(jr);
+    ASSERT(jr_nchild(jr_object_at(jr, "meta")) == 1);
+    ASSERT(jr_nchild(jr_object_at(jr_object_at(jr, "b"), "c")) == 2);
+    ASSERT(jr_as_long(jr_array_at(jr, 1)) == 2);
+
+    jr_reset(jr);
+    jr_object_at(jr, "items");
+    ASSERT(jr_nchild(jr) == 3);
+    ASSERT(jr_long_of(jr_array_at(jr, 1), "k") == 4);
+    ASSERT(jr_nchild(jr) == 1);
+    jr_reset(jr);
+    ASSERT(jr_as_long(jr_array_at(jr_object_at(jr, "items"), 2)) == 5);
+    ASSERT(jr_error() == JR_OK);
+
+    /* With stop, what follows the last path is never read */
+    char cut[] = "{\"id\": 1, \"name\": \"n\", \"data\": \"unterminated";
+    struct jr_project first = {0};
+    jr_project_init(&first, true, 8, select);
+    ASSERT(jr_project_add(&first, "name") == JR_OK);
+    ASSERT(jr_project_add(&first, "id") == JR_OK);
+    JR_INIT(jr);
+    ASSERT(jr_parse_project(jr, &first, strlen(cut), cut) == JR_OK);
+    ASSERT(jr_nchild(jr) == 2);
+    ASSERT(!strcmp(jr_string_of(jr, "name"), "n"));
+    first.stop = false;
+    ASSERT(jr_parse_project(jr, &first, strlen(cut), cut) == JR_INVAL);
+
+    /* Later elements of an array can match again */
+    char later[] = "{\"x\": [{\"a\": 1}, {\"b\": 3, \"a\": 4}], \"y\": \"cut";
+    char top[] = "[{\"a\": 1}, {\"a\": 2}]";
+    jr_project_init(&first, true, 8, select);
+    ASSERT(jr_project_add(&first, "x.a") == JR_OK);
+    ASSERT(jr_parse_project(jr, &first, strlen(later), later) == JR_OK);
+    ASSERT(jr_nchild(jr_object_at(jr, "x")) == 2);
+    ASSERT(jr_long_of(jr_array_at(jr, 1), "a") == 4);
+    jr_project_init(&first, true, 8, select);
+    ASSERT(jr_project_add(&first, "a") == JR_OK);
+    ASSERT(jr_parse_project(jr, &first, strlen(top), top) == JR_OK);
+    ASSERT(jr_long_of(jr_array_at(jr, 1), "a") == 2);
+
+    struct jr_project full = {0};
+    jr_project_init(&full, false, 2, select);
+    ASSERT(jr_project_add(&full, "a.b") == JR_OK);
+    ASSERT(jr_project_add(&full, "a.c") == JR_NOMEM);
+    ASSERT(jr_project_add(&full, "a") == JR_OK);
+}
+
+static char path_json[] =
+    "{\"results\":[{\"rank\":1,\"a/b\":2},{\"rank\":3},{\"x\":4},"
+    "{\"rank\":5},{\"rank\":[6]}],\"0\":{\"rank\":7},\"n\":8}";
+
+struct path_matches
+{
+    int count;
+    long value[8];
+};
+
+static int path_collect(struct jr_iter *it, void *arg)
+{
+    struct path_matches *m = arg;
+    if (jr_iter_type(it) != JR_NUMBER) return 0;
+    m->value[m->count++] = jr_iter_long(it);
+    return m->count == 8 ? JR_NOMEM : 0;
+}
+
+static int path_query(struct jr const jr[], char const *expr)
+{
+    struct jr_step step[8];
+    struct jr_path path = {0};
+    struct path_matches m = {0};
+    ASSERT(jr_path_compile(&path, 8, step, expr) == JR_OK);
+    ASSERT(jr_path_eval(&path, jr, path_collect, &m) == JR_OK);
+    long sum = 0;
+    for (int i = 0; i < m.count; ++i)
+        sum = sum * 10 + m.value[i];
+    return (int)sum;
+}
+
+static void test_path(void)
+{
+    JR_INIT(jr);
+    ASSERT(!jr_parse(jr, strlen(path_json), path_json));
+
+    ASSERT(path_query(jr, "results[*].rank") == 135);
+    ASSERT(path_query(jr, "$.results[*].rank[0]") == 6);
+    ASSERT(path_query(jr, "$.results[1].rank") == 3);
+    ASSERT(path_query(jr, "results[-2].rank") == 5);
+    ASSERT(path_query(jr, "results[9].rank") == 0);
+    ASSERT(path_query(jr, "results[1:].rank") == 35);
+    ASSERT(path_query(jr, "results[::2].rank") == 1);
+    ASSERT(path_query(jr, "results[1::2].rank") == 35);
+    ASSERT(path_query(jr, "results[-3:-1].rank") == 5);
+    ASSERT(path_query(jr, "$['0'].rank") == 7);
+    ASSERT(path_query(jr, "$.*") == 8);
+    ASSERT(path_query(jr, "*.rank") == 7);
+    ASSERT(path_query(jr, "n") == 8);
+    ASSERT(path_query(jr, "n.rank") == 0);
+    ASSERT(path_query(jr, "/results/0/a/b") == 0);
+    ASSERT(path_query(jr, "/results/0/rank") == 1);
+    ASSERT(path_query(jr, "/0/rank") == 7);
+    ASSERT(path_query(jr, "/results/00/rank") == 0);
+    ASSERT(path_query(jr, "/n") == 8);
+    ASSERT(path_query(jr, "") == 0);
+
+    /* A non-zero return from the callback ends the walk */
+    struct jr_step step[4];
+    struct jr_path path = {0};
+    struct path_matches m = {.count = 7};
+    ASSERT(jr_path_compile(&path, 4, step, "results[*].rank") == JR_OK);
+    ASSERT(jr_path_eval(&path, jr, path_collect, &m) == JR_NOMEM);
+    ASSERT(m.count == 8 && m.value[7] == 1);
+
+    ASSERT(jr_path_compile(&path, 4, step, "results[") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "results..rank") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "results[0]x") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "results[::0]") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "$['rank]") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "/a~1b") == JR_INVAL);
+    ASSERT(jr_path_compile(&path, 4, step, "a.b.c.d.e") == JR_NOMEM);
+    ASSERT(jr_path_compile(&path, 4, step,
+                           "[99999999999999999999]") == JR_OUTRANGE);
+    ASSERT(jr_path_compile(&path, 4, step, "$") == JR_OK);
+    ASSERT(path.count == 0);
+}
+
+struct sample
+{
+    long id;
+    char name[8];
+    double score;
+    bool ok;
+    int rank;
+    unsigned long reads;
+    struct jr_strview tag;
+};
+
+#define SAMPLE_FIELDS(X)                                                       \
+    X(struct sample, id, LONG)                                                 \
+    X(struct sample, name, STRING)                                             \
+    X(struct sample, score, DOUBLE)                                            \
+    X(struct sample, ok, BOOL)                                                 \
+    X(struct sample, rank, INT)                                                \
+    X(struct sample, reads, ULONG)                                             \
+    X(struct sample, tag, STRVIEW)
+
+static struct jr_field const sample_fields[] = {SAMPLE_FIELDS(JR_FIELD)};
+enum
+{
+    NSAMPLE_FIELDS = sizeof(sample_fields) / sizeof(sample_fields[0])
+};
+
+static void test_bind(void)
+{
+    char json[] = "{\"id\":7,\"name\":\"a\\tb\",\"score\":1.5,\"ok\":true,"
+                  "\"rank\":-3,\"reads\":18446744073709551615,\"tag\":\"x\"}";
+    JR_INIT(jr);
+    ASSERT(!jr_parse(jr, strlen(json), json));
+
+    struct sample s = {0};
+    struct jr_bound b = jr_bind(jr, NSAMPLE_FIELDS, sample_fields, &s);
+    ASSERT(b.missing == 0 && b.mistyped == 0);
+    ASSERT(s.id == 7 && !strcmp(s.name, "a\tb") && s.score == 1.5 && s.ok);
+    ASSERT(s.rank == -3 && s.reads == ULONG_MAX);
+    ASSERT(s.tag.len == 1 && s.tag.ptr[0] == 'x');
+    ASSERT(jr_type(jr) == JR_OBJECT);
+    ASSERT(jr_error() == JR_OK);
+
+    /* Out of order, duplicated, unknown, missing and mistyped members */
+    char other[] = "{\"zz\":[1,{\"id\":1}],\"rank\":5000000000,\"ok\":1,"
+                   "\"id\":9,\"id\":10,\"name\":\"too long\",\"score\":2}";
+    ASSERT(!jr_parse(jr, strlen(other), other));
+    struct sample t = {.rank = 1, .ok = true, .reads = 3};
+    b = jr_bind(jr, NSAMPLE_FIELDS, sample_fields, &t);
+    ASSERT(b.missing == ((1 << 5) | (1 << 6)));
+    ASSERT(b.mistyped == ((1 << 1) | (1 << 3) | (1 << 4)));
+    ASSERT(t.id == 9 && t.score == 2 && t.ok && t.rank == 1 && t.reads == 3);
+    ASSERT(jr_error() == JR_OK);
+
+    /* A table whose sizes disagree with the types writes nothing */
+    struct jr_field const narrow[] = {
+        {"id", JR_FIELD_LONG, offsetof(struct sample, ok), sizeof(bool)},
+        {"score", JR_FIELD_BOOL, offsetof(struct sample, score),
+         sizeof(double)},
+    };
+    t.ok = false;
+    b = jr_bind(jr, 2, narrow, &t);
+    ASSERT(b.missing == 0 && b.mistyped == 3);
+    ASSERT(!t.ok && t.score == 2);
+    ASSERT(jr_error() == JR_OK);
+
+    jr_down(jr);
+    b = jr_bind(jr, NSAMPLE_FIELDS, sample_fields, &t);
+    ASSERT(b.missing == (1 << NSAMPLE_FIELDS) - 1);
+    ASSERT(jr_error() == JR_INVAL);
+}
+
+struct record
+{
+    long id;
+    char name[8];
+    struct jr_strview data;
+};
+
+#define RECORD_FIELDS(X)                                                       \
+    X(struct record, id, LONG)                                                 \
+    X(struct record, name, STRING)                                             \
+    X(struct record, data, STRVIEW)
+
+JR_SCHEMA(record_parse, struct record, RECORD_FIELDS)
+
+static void test_schema(void)
+{
+    char marker[] = "[1]";
+    JR_INIT(jr);
+    ASSERT(!jr_parse(jr, strlen(marker), marker));
+
+    /* The expected shape never touches jr */
+    char fast[] = " { \"id\" : 5 , \"name\":\"Homo\" ,\"data\" : \"ACGT\" }\n";
+    struct record r = {0};
+    struct jr_bound b = record_parse(jr, strlen(fast), fast, &r);
+    ASSERT(b.missing == 0 && b.mistyped == 0);
+    ASSERT(r.id == 5 && !strcmp(r.name, "Homo"));
+    ASSERT(r.data.len == 4 && !memcmp(r.data.ptr, "ACGT", 4));
+    ASSERT(jr_type(jr) == JR_ARRAY);
+
+    /* Anything else goes through the generic parser */
+    char moved[] = "{\"name\":\"a\\tb\",\"id\":2,\"data\":\"C\"}";
+    b = record_parse(jr, strlen(moved), moved, &r);
+    ASSERT(b.missing == 0 && b.mistyped == 0);
+    ASSERT(r.id == 2 && !strcmp(r.name, "a\tb") && r.data.len == 1);
+    ASSERT(jr_type(jr) == JR_OBJECT);
+
+    char partial[] = "{\"id\":1.5,\"name\":\"too long\",\"x\":1}";
+    b = record_parse(jr, strlen(partial), partial, &r);
+    ASSERT(b.missing == 4 && b.mistyped == 3);
+    ASSERT(r.id == 2 && jr_error() == JR_OK);
+
+    char *bad[] = {"{\"id\":01,\"name\":\"n\",\"data\":\"d\"}",
+                   "{\"id\":1,\"name\":\"n\",\"data\":\"d\"} x",
+                   "{\"id\":1,\"name\":\"n\",\"data\":\"d\""};
+    for (int i = 0; i < 3; ++i)
+    {
+        b = record_parse(jr, strlen(bad[i]), bad[i], &r);
+        ASSERT(b.missing == 7 && jr_error() == JR_INVAL);
+        /* Not even what the fast path read before it gave up */
+        ASSERT(r.id == 2 && r.data.len == 1);
+    }
+    JR_DECLARE(small, JR_SIZE_FOR(2));
+    JR_INIT(small);
+    b = record_parse(small, strlen(moved), moved, &r);
+    ASSERT(b.missing == 7 && b.mistyped == 0 && jr_error() == JR_NOMEM);
+    ASSERT(r.id == 2);
+
+    char dna[] = "{\"id\":1,\"name\":\"Homo\",\"data\":\"ACGT\"}";
+    ASSERT(!jr_parse(jr, strlen(marker), marker));
+    b = record_parse(jr, strlen(dna), dna, &r);
+    ASSERT(b.missing == 0 && r.id == 1 && jr_type(jr) == JR_ARRAY);
+}
+
+struct sax_trace
+{
+    char events[64];
+    int count;
+    double sum;
+    char const *skip;
+};
+
+static int sax_record(struct jr_sax const *sax, void *arg)
+{
+    struct sax_trace *t = arg;
+    char const *code = "{}[]ksnbz";
+    t->events[t->count++] = code[sax->event];
+    t->events[t->count] = '\0';
+    if (sax->event == JR_SAX_NUMBER)
+    {
+        double val = 0;
+        ASSERT(jr_sax_double(sax, &val) == JR_OK);
+        t->sum += val;
+    }
+    if (sax->event == JR_SAX_KEY && t->skip &&
+        !strncmp(sax->json + sax->start, t->skip, sax->end - sax->start))
+        return JR_SAX_SKIP;
+    if (sax->event == JR_SAX_ARRAY && sax->depth == 3) return JR_SAX_SKIP;
+    if (sax->event == JR_SAX_NULL) return JR_NOTFOUND;
+    return JR_OK;
+}
+
+static void test_sax(void)
+{
+    char const json[] = "{\"a\": [1, 2.5, {}, [3, [4]], \"s\"], \"b\": {\"c\": "
+                        "[5]}, \"d\": true, \"e\\n\": []}";
+    jr_idx length = (jr_idx)strlen(json);
+    struct sax_trace t = {0};
+    jr_idx offset = 0;
+    ASSERT(jr_parse_sax(json, length, &offset, sax_record, &t) == JR_OK);
+    ASSERT(!strcmp(t.events, "{k[nn{}[n[]s]k{k[n]}kbk[]}"));
+    ASSERT(t.sum == 1 + 2.5 + 3 + 5 && offset == length);
+
+    /* Skipped values give no events, not even their end */
+    struct sax_trace skip = {.skip = "b"};
+    ASSERT(jr_parse_sax(json, length, NULL, sax_record, &skip) == JR_OK);
+    ASSERT(!strcmp(skip.events, "{k[nn{}[n[]s]kkbk[]}"));
+
+    struct sax_trace stop = {0};
+    char const nulls[] = "[1, null, 2]";
+    ASSERT(jr_parse_sax(nulls, (jr_idx)strlen(nulls), &offset, sax_record,
+                        &stop) == JR_NOTFOUND);
+    ASSERT(!strcmp(stop.events, "[nz") && offset == 8);
+
+    /* Events come as tokens are checked, ahead of a later error */
+    struct sax_trace bad = {0};
+    char const cut[] = "{\"k\": -1e2, \"v\": [tru]}";
+    ASSERT(jr_parse_sax(cut, (jr_idx)strlen(cut), &offset, sax_record,
+                        &bad) == JR_INVAL);
+    ASSERT(!strcmp(bad.events, "{knk[") && bad.sum == -100 && offset == 18);
+    ASSERT(jr_parse_sax(cut, 9, &offset, NULL, NULL) == JR_INVAL);
+    ASSERT(offset == 6);
+}